@@ -6,8 +6,10 @@ namespace cbox {
 // --- context ---
 // ---------------
 
-context::context(utils::cfg &cfg, Pistache::Http::ResponseWriter *rw) :
-  cfg_(cfg), response_writer_(rw) {}
+context::context(utils::cfg &cfg,
+                 utils::capacity_hint &out_hint,
+                 Pistache::Http::ResponseWriter *rw) :
+  cfg_(cfg), out_hint_(out_hint), response_writer_(rw) {}
 
 int context::init(std::shared_ptr<spdlog::logger> &event_log)
 {
@@ -20,9 +22,20 @@ int context::init(std::shared_ptr<spdlog::logger> &event_log)
       output_.reset(new std::ostream(std::cout.rdbuf()));
     } else if(cfg_.out_channel == "stderr") {
       output_.reset(new std::ostream(std::cerr.rdbuf()));
+    } else if(auto cdc = utils::compressed_filebuf::codec_of(cfg_.out_channel)) {
+      out_buf_.reset(new utils::compressed_filebuf());
+      if(!out_buf_->open(cfg_.out_channel, *cdc, cfg_.out_compression_level)) {
+        event_log_->error("failed to open output channel:{}", cfg_.out_channel);
+        return 1;
+      }
+      output_.reset(new std::ostream(out_buf_.get()));
     } else {
       output_.reset(new std::ofstream(cfg_.out_channel));
     }
+    //with no output there are no events either
+    if(cfg_.out_format == STR_NDJSON && !cfg_.no_out_) {
+      event_writer_.start(*output_);
+    }
   }
 
   //init scenario
@@ -81,17 +94,59 @@ int context::load_document_by_string(const std::string &str)
 int context::load_document()
 {
   int res = 0;
-  ryml::set_callbacks(REH_.callbacks());
+  REH_.install();
   REH_.check_error_occurs([&] {
     doc_in_ = ryml::parse_in_place(ryml::to_substr(ryml_load_buf_));
   }, [&](std::runtime_error const &e) {
     event_log_->error("malformed document\n{}", e.what());
     res = 1;
   });
-  ryml::set_callbacks(REH_.defaults);
+  REH_.uninstall();
   return res;
 }
 
+int context::decode_document_by_file()
+{
+  auto fmt = codec::format_from(cfg_.decode);
+  if(!fmt) {
+    event_log_->error("bad binary format:{}", cfg_.decode);
+    return 1;
+  }
+
+  std::string file_name;
+  if(cfg_.in_path.empty()) {
+    utils::base_name(cfg_.in_name,
+                     cfg_.in_path,
+                     file_name);
+  } else {
+    file_name = cfg_.in_name;
+  }
+
+  std::ostringstream fpath;
+  fpath << cfg_.in_path << "/" << file_name;
+  int error = 0;
+  if(!utils::file_get_contents(fpath.str().c_str(), ryml_load_buf_, event_log_.get(), error)) {
+    if(!error) {
+      event_log_->error("empty file");
+    }
+    return 1;
+  }
+
+  //the output is a sequence of items: the scenarios or the streamed records
+  std::string_view in(ryml_load_buf_.data(), ryml_load_buf_.size());
+  size_t pos = 0;
+  std::string decode_error;
+  while(pos < in.size()) {
+    ryml::Tree doc;
+    if(!codec::decode(in, pos, *fmt, doc.rootref(), decode_error)) {
+      event_log_->error("malformed {} at offset {}:{}", cfg_.decode, pos, decode_error);
+      return 1;
+    }
+    *output_ << YAML_DOC_SEP << std::endl << doc;
+  }
+  return 0;
+}
+
 int context::process_scenario()
 {
   int res = 0;
@@ -100,12 +155,15 @@ int context::process_scenario()
     event_log_->error("empty document");
     return 1;
   } else if(stream.is_stream()) {
+    scenario_idx_ = 0;
     for(ryml::NodeRef doc : stream.children()) {
       if((res = scenario_->process(doc_in_, doc))) {
         return res;
       }
+      ++scenario_idx_;
     }
   } else {
+    scenario_idx_ = 0;
     if((res = scenario_->process(doc_in_, doc_in_.rootref()))) {
       return res;
     }
@@ -114,6 +172,24 @@ int context::process_scenario()
   return -1;
 }
 
+int context::close_output()
+{
+  if(!output_) {
+    return 0;
+  }
+  event_writer_.stop();
+  output_->flush();
+  bool written = !output_->bad();
+  if(out_buf_ && !out_buf_->close()) {
+    written = false;
+  }
+  if(!written) {
+    event_log_->error("failed to write output channel:{}", cfg_.out_channel);
+    return 1;
+  }
+  return 0;
+}
+
 // -----------
 // --- env ---
 // -----------
@@ -164,18 +240,24 @@ int env::exec()
     }
     res = endpoint_->start();
   } else {
-    context ctx(cfg_);
+    context ctx(cfg_, out_hint_);
     if((res = ctx.init(event_log_))) {
       return res;
     }
-    if((res = ctx.load_document_by_file())) {
-      return res;
+    if(!cfg_.decode.empty()) {
+      res = ctx.decode_document_by_file();
+    } else if(!(res = ctx.load_document_by_file())) {
+      while(!(res = ctx.process_scenario()));
+
+      //a negative value means no more scenarios
+      if(res<0) {
+        res = 0;
+      }
     }
-    while(!(res = ctx.process_scenario()));
 
-    //a negative value means no more scenarios
-    if(res<0) {
-      res = 0;
+    //an output that could not be written, e.g. on a full disk, fails the run
+    if(ctx.close_output() && !res) {
+      res = 1;
     }
   }
 
@@ -1,11 +1,14 @@
 #pragma once
 #include "jsenv.h"
+#include "codec.h"
 
 namespace cbox {
 
 struct context {
 
-  context(utils::cfg &cfg, Pistache::Http::ResponseWriter *rw = nullptr);
+  context(utils::cfg &cfg,
+          utils::capacity_hint &out_hint,
+          Pistache::Http::ResponseWriter *rw = nullptr);
 
   int init(std::shared_ptr<spdlog::logger> &event_log);
 
@@ -14,13 +17,26 @@ struct context {
   int load_document_by_string(const std::string &str);
   int load_document();
 
+  //writes the binary output file as yaml documents
+  int decode_document_by_file();
+
   int process_scenario();
 
+  //writes out what is pending and closes the output channel,
+  //non-zero when the output could not be written whole
+  int close_output();
+
   utils::cfg &cfg_;
 
+  //scenario-out reservations, learned across contexts
+  utils::capacity_hint &out_hint_;
+
   //ryml error handler
   utils::RymlErrorHandler REH_;
 
+  //open sockets per host, across scenario shards
+  utils::conn_gauge conn_gauge_;
+
   //ryml document-in load buffer
   std::vector<char> ryml_load_buf_;
 
@@ -30,9 +46,18 @@ struct context {
   //scenario
   std::unique_ptr<cbox::scenario> scenario_;
 
+  //compressing buffer of a .gz or .zst output channel; destroyed after output_
+  std::unique_ptr<utils::compressed_filebuf> out_buf_;
+
   //output
   std::unique_ptr<std::ostream> output_;
 
+  //ndjson event lines, written off the request path; destroyed before output_
+  utils::line_writer event_writer_;
+
+  //the index of the scenario being processed
+  uint32_t scenario_idx_ = 0;
+
   //endpoint-output
   Pistache::Http::ResponseWriter *response_writer_;
 
@@ -50,6 +75,9 @@ struct env {
 
   utils::cfg cfg_;
 
+  //scenario-out reservations, adapting across the documents a daemon runs
+  utils::capacity_hint out_hint_;
+
   //endpoint
   std::unique_ptr<rest::endpoint> endpoint_;
 
@@ -0,0 +1,822 @@
+#include "codec.h"
+
+#define ERR_TRUNCATED       "truncated input"
+#define ERR_BAD_TYPE        "unsupported item type"
+#define ERR_TOO_DEEP        "nesting too deep"
+#define ERR_XML_MARKUP      "malformed markup"
+#define ERR_XML_ENTITY      "unknown entity"
+#define ERR_XML_MISMATCH    "mismatched closing tag"
+#define ERR_XML_UNCLOSED    "unclosed element"
+#define ERR_XML_NO_ROOT     "no root element"
+
+//decoding recursion bound, deeper input is rejected as malformed
+#define MAX_DEPTH 512
+
+namespace codec {
+
+std::optional<format> format_from(const std::string &name)
+{
+  if(name == STR_CBOR) {
+    return cbor;
+  }
+  if(name == STR_MSGPACK) {
+    return msgpack;
+  }
+  return std::nullopt;
+}
+
+// --------------
+// --- ENCODE ---
+// --------------
+
+static void put_be(std::string &out, uint64_t val, uint32_t bytes)
+{
+  for(uint32_t it = bytes; it > 0; --it) {
+    out += (char)((val >> ((it - 1) * 8)) & 0xff);
+  }
+}
+
+//a cbor head: major type and argument in the shortest form
+static void cbor_head(std::string &out, uint8_t major, uint64_t arg)
+{
+  major <<= 5;
+  if(arg < 24) {
+    out += (char)(major | arg);
+  } else if(arg <= 0xff) {
+    out += (char)(major | 24);
+    put_be(out, arg, 1);
+  } else if(arg <= 0xffff) {
+    out += (char)(major | 25);
+    put_be(out, arg, 2);
+  } else if(arg <= 0xffffffff) {
+    out += (char)(major | 26);
+    put_be(out, arg, 4);
+  } else {
+    out += (char)(major | 27);
+    put_be(out, arg, 8);
+  }
+}
+
+//a msgpack length prefix: fix form when it fits, else 16 or 32 bits
+static void msgpack_len(std::string &out, uint64_t len, uint8_t fix, uint64_t fix_max, uint8_t len8, uint8_t len16, uint8_t len32)
+{
+  if(len <= fix_max) {
+    out += (char)(fix | len);
+  } else if(len8 && len <= 0xff) {
+    out += (char)len8;
+    put_be(out, len, 1);
+  } else if(len <= 0xffff) {
+    out += (char)len16;
+    put_be(out, len, 2);
+  } else {
+    out += (char)len32;
+    put_be(out, len, 4);
+  }
+}
+
+static void encode_str(std::string &out, format fmt, ryml::csubstr str)
+{
+  if(fmt == cbor) {
+    cbor_head(out, 3, str.len);
+  } else {
+    msgpack_len(out, str.len, 0xa0, 31, 0xd9, 0xda, 0xdb);
+  }
+  out.append(str.str, str.len);
+}
+
+static void encode_int(std::string &out, format fmt, int64_t val)
+{
+  if(fmt == cbor) {
+    if(val >= 0) {
+      cbor_head(out, 0, (uint64_t)val);
+    } else {
+      cbor_head(out, 1, (uint64_t)(-1 - val));
+    }
+    return;
+  }
+  if(val >= 0) {
+    if(val < 128) {
+      out += (char)val;
+    } else if(val <= 0xff) {
+      out += (char)0xcc;
+      put_be(out, val, 1);
+    } else if(val <= 0xffff) {
+      out += (char)0xcd;
+      put_be(out, val, 2);
+    } else if(val <= 0xffffffff) {
+      out += (char)0xce;
+      put_be(out, val, 4);
+    } else {
+      out += (char)0xcf;
+      put_be(out, val, 8);
+    }
+  } else if(val >= -32) {
+    out += (char)(uint8_t)val;
+  } else if(val >= INT8_MIN) {
+    out += (char)0xd0;
+    put_be(out, (uint64_t)val, 1);
+  } else if(val >= INT16_MIN) {
+    out += (char)0xd1;
+    put_be(out, (uint64_t)val, 2);
+  } else if(val >= INT32_MIN) {
+    out += (char)0xd2;
+    put_be(out, (uint64_t)val, 4);
+  } else {
+    out += (char)0xd3;
+    put_be(out, (uint64_t)val, 8);
+  }
+}
+
+static void encode_scalar(std::string &out, format fmt, const ryml::Tree &t, size_t id)
+{
+  ryml::csubstr val = t.val(id);
+  std::string_view str(val.str, val.len);
+  switch(utils::scalar_kind_of(ryml::ConstNodeRef(&t, id))) {
+    case utils::scalar_null:
+      out += (char)(fmt == cbor ? 0xf6 : 0xc0);
+      return;
+    case utils::scalar_bool:
+      if(fmt == cbor) {
+        out += (char)(str == "true" ? 0xf5 : 0xf4);
+      } else {
+        out += (char)(str == "true" ? 0xc3 : 0xc2);
+      }
+      return;
+    case utils::scalar_int:
+      encode_int(out, fmt, *utils::parse<int64_t>(str[0] == '+' ? str.substr(1) : str));
+      return;
+    case utils::scalar_float: {
+      double num = *utils::parse<double>(str[0] == '+' ? str.substr(1) : str);
+      out += (char)(fmt == cbor ? 0xfb : 0xcb);
+      put_be(out, std::bit_cast<uint64_t>(num), 8);
+      return;
+    }
+    default:
+      encode_str(out, fmt, val);
+  }
+}
+
+void encode(const ryml::Tree &t,
+            size_t id,
+            format fmt,
+            std::string &out)
+{
+  if(t.is_map(id) || t.is_seq(id)) {
+    bool map = t.is_map(id);
+    size_t count = t.num_children(id);
+    if(fmt == cbor) {
+      cbor_head(out, map ? 5 : 4, count);
+    } else if(map) {
+      msgpack_len(out, count, 0x80, 15, 0, 0xde, 0xdf);
+    } else {
+      msgpack_len(out, count, 0x90, 15, 0, 0xdc, 0xdd);
+    }
+    for(size_t ch = t.first_child(id); ch != ryml::NONE; ch = t.next_sibling(ch)) {
+      if(map) {
+        encode_str(out, fmt, t.key(ch));
+      }
+      encode(t, ch, fmt, out);
+    }
+  } else if(t.has_val(id)) {
+    encode_scalar(out, fmt, t, id);
+  } else {
+    out += (char)(fmt == cbor ? 0xf6 : 0xc0);
+  }
+}
+
+// --------------
+// --- DECODE ---
+// --------------
+
+namespace {
+
+struct decoder {
+
+  bool need(size_t bytes) {
+    if(in_.size() - pos_ < bytes) {
+      error_ = ERR_TRUNCATED;
+      return false;
+    }
+    return true;
+  }
+
+  uint64_t get_be(uint32_t bytes) {
+    uint64_t val = 0;
+    for(uint32_t it = 0; it < bytes; ++it) {
+      val = (val << 8) | (uint8_t)in_[pos_++];
+    }
+    return val;
+  }
+
+  //a scalar written as its yaml text
+  void put_scalar(ryml::NodeRef to, std::string_view text) {
+    to.set_val(to.to_arena(ryml::csubstr(text.data(), text.size())));
+  }
+
+  //a string is quoted when its plain text would read as another type
+  void put_str(ryml::NodeRef to, std::string_view str) {
+    put_scalar(to, str);
+    if(str.empty() || utils::scalar_kind_of(to) != utils::scalar_string) {
+      to |= ryml::VALQUO;
+    }
+  }
+
+  //encode writes string keys only
+  bool key(std::string_view &out) {
+    if(!need(1)) {
+      return false;
+    }
+    uint8_t b = (uint8_t)in_[pos_++];
+    uint64_t len = 0;
+    if(fmt_ == cbor) {
+      uint8_t info = b & 0x1f;
+      if((b >> 5) != 3 || info > 27) {
+        error_ = ERR_BAD_TYPE;
+        return false;
+      }
+      len = info;
+      if(info >= 24) {
+        uint32_t bytes = 1u << (info - 24);
+        if(!need(bytes)) {
+          return false;
+        }
+        len = get_be(bytes);
+      }
+    } else if((b & 0xe0) == 0xa0) {
+      len = b & 0x1f;
+    } else if(b >= 0xd9 && b <= 0xdb) {
+      uint32_t bytes = 1u << (b - 0xd9);
+      if(!need(bytes)) {
+        return false;
+      }
+      len = get_be(bytes);
+    } else {
+      error_ = ERR_BAD_TYPE;
+      return false;
+    }
+    if(!need(len)) {
+      return false;
+    }
+    out = in_.substr(pos_, len);
+    pos_ += len;
+    return true;
+  }
+
+  bool item(ryml::NodeRef to, uint32_t depth) {
+    if(depth > MAX_DEPTH) {
+      error_ = ERR_TOO_DEEP;
+      return false;
+    }
+    if(!need(1)) {
+      return false;
+    }
+    return fmt_ == cbor ? cbor_item(to, depth) : msgpack_item(to, depth);
+  }
+
+  bool container(ryml::NodeRef to, bool map, uint64_t count, uint32_t depth) {
+    to |= (map ? ryml::MAP : ryml::SEQ);
+    for(uint64_t it = 0; it < count; ++it) {
+      ryml::NodeRef child = to.append_child();
+      if(map) {
+        std::string_view k;
+        if(!key(k)) {
+          return false;
+        }
+        child.set_key(child.to_arena(ryml::csubstr(k.data(), k.size())));
+      }
+      if(!item(child, depth + 1)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool cbor_item(ryml::NodeRef to, uint32_t depth) {
+    uint8_t ib = (uint8_t)in_[pos_++];
+    uint8_t major = ib >> 5, info = ib & 0x1f;
+
+    if(major == 7) {
+      switch(info) {
+        case 20:
+          put_scalar(to, "false");
+          return true;
+        case 21:
+          put_scalar(to, "true");
+          return true;
+        case 22:
+        case 23:
+          put_scalar(to, "~");
+          return true;
+        case 26:
+          if(!need(4)) {
+            return false;
+          }
+          put_double(to, std::bit_cast<float>((uint32_t)get_be(4)));
+          return true;
+        case 27:
+          if(!need(8)) {
+            return false;
+          }
+          put_double(to, std::bit_cast<double>(get_be(8)));
+          return true;
+        default:
+          error_ = ERR_BAD_TYPE;
+          return false;
+      }
+    }
+
+    uint64_t arg = info;
+    if(info >= 24 && info <= 27) {
+      uint32_t bytes = 1u << (info - 24);
+      if(!need(bytes)) {
+        return false;
+      }
+      arg = get_be(bytes);
+    } else if(info > 27) {
+      //indefinite lengths are not written by encode
+      error_ = ERR_BAD_TYPE;
+      return false;
+    }
+
+    switch(major) {
+      case 0:
+        put_scalar(to, utils::to_str(arg));
+        return true;
+      case 1:
+        if(arg > (uint64_t)INT64_MAX) {
+          error_ = ERR_BAD_TYPE;
+          return false;
+        }
+        put_scalar(to, utils::to_str(-1 - (int64_t)arg));
+        return true;
+      case 2:
+      case 3:
+        if(!need(arg)) {
+          return false;
+        }
+        put_str(to, in_.substr(pos_, arg));
+        pos_ += arg;
+        return true;
+      case 4:
+        return container(to, false, arg, depth);
+      case 5:
+        return container(to, true, arg, depth);
+      default:
+        //tags are not written by encode
+        error_ = ERR_BAD_TYPE;
+        return false;
+    }
+  }
+
+  bool msgpack_item(ryml::NodeRef to, uint32_t depth) {
+    uint8_t b = (uint8_t)in_[pos_++];
+
+    if(b < 0x80) {
+      put_scalar(to, utils::to_str(b));
+      return true;
+    }
+    if(b >= 0xe0) {
+      put_scalar(to, utils::to_str((int8_t)b));
+      return true;
+    }
+    if((b & 0xf0) == 0x80) {
+      return container(to, true, b & 0x0f, depth);
+    }
+    if((b & 0xf0) == 0x90) {
+      return container(to, false, b & 0x0f, depth);
+    }
+    if((b & 0xe0) == 0xa0) {
+      return str(to, b & 0x1f);
+    }
+
+    switch(b) {
+      case 0xc0:
+        put_scalar(to, "~");
+        return true;
+      case 0xc2:
+        put_scalar(to, "false");
+        return true;
+      case 0xc3:
+        put_scalar(to, "true");
+        return true;
+      case 0xca:
+        if(!need(4)) {
+          return false;
+        }
+        put_double(to, std::bit_cast<float>((uint32_t)get_be(4)));
+        return true;
+      case 0xcb:
+        if(!need(8)) {
+          return false;
+        }
+        put_double(to, std::bit_cast<double>(get_be(8)));
+        return true;
+      case 0xcc:
+      case 0xcd:
+      case 0xce:
+      case 0xcf: {
+        uint32_t bytes = 1u << (b - 0xcc);
+        if(!need(bytes)) {
+          return false;
+        }
+        put_scalar(to, utils::to_str(get_be(bytes)));
+        return true;
+      }
+      case 0xd0:
+      case 0xd1:
+      case 0xd2:
+      case 0xd3: {
+        uint32_t bytes = 1u << (b - 0xd0);
+        if(!need(bytes)) {
+          return false;
+        }
+        //sign extension from the encoded width
+        uint32_t shift = 64 - bytes * 8;
+        int64_t val = (int64_t)(get_be(bytes) << shift) >> shift;
+        put_scalar(to, utils::to_str(val));
+        return true;
+      }
+      case 0xc4:
+      case 0xd9:
+        return len_then(1, [&](uint64_t len) {
+          return str(to, len);
+        });
+      case 0xc5:
+      case 0xda:
+        return len_then(2, [&](uint64_t len) {
+          return str(to, len);
+        });
+      case 0xc6:
+      case 0xdb:
+        return len_then(4, [&](uint64_t len) {
+          return str(to, len);
+        });
+      case 0xdc:
+        return len_then(2, [&](uint64_t len) {
+          return container(to, false, len, depth);
+        });
+      case 0xdd:
+        return len_then(4, [&](uint64_t len) {
+          return container(to, false, len, depth);
+        });
+      case 0xde:
+        return len_then(2, [&](uint64_t len) {
+          return container(to, true, len, depth);
+        });
+      case 0xdf:
+        return len_then(4, [&](uint64_t len) {
+          return container(to, true, len, depth);
+        });
+      default:
+        //extension types are not written by encode
+        error_ = ERR_BAD_TYPE;
+        return false;
+    }
+  }
+
+  template <typename F>
+  bool len_then(uint32_t bytes, F &&then) {
+    if(!need(bytes)) {
+      return false;
+    }
+    return then(get_be(bytes));
+  }
+
+  bool str(ryml::NodeRef to, uint64_t len) {
+    if(!need(len)) {
+      return false;
+    }
+    put_str(to, in_.substr(pos_, len));
+    pos_ += len;
+    return true;
+  }
+
+  //an integral float keeps a fraction, so that it reads back as a float
+  void put_double(ryml::NodeRef to, double num) {
+    std::string text = fmt::format("{}", num);
+    if(std::isfinite(num) && text.find_first_of(".e") == std::string::npos) {
+      text += ".0";
+    }
+    put_scalar(to, text);
+  }
+
+  std::string_view in_;
+  size_t pos_;
+  format fmt_;
+  std::string &error_;
+};
+
+}
+
+bool decode(std::string_view in,
+            size_t &pos,
+            format fmt,
+            ryml::NodeRef to,
+            std::string &error)
+{
+  decoder dec{in, pos, fmt, error};
+  bool res = dec.item(to, 0);
+  pos = dec.pos_;
+  return res;
+}
+
+// -----------
+// --- XML ---
+// -----------
+
+namespace {
+
+struct xml_parser {
+
+  //an open element
+  struct frame {
+    size_t id;
+    ryml::csubstr name;
+
+    //the element has child elements, its text is dropped
+    bool parent = false;
+
+    //the decoded text, compacted in place where it starts
+    char *text = nullptr;
+    size_t text_len = 0;
+
+    //the last child, where a run of repeated siblings is looked for first
+    size_t last = ryml::NONE;
+  };
+
+  bool parse() {
+    while(pos_ < src_.len) {
+      if(src_[pos_] != '<') {
+        size_t end = src_.find('<', pos_);
+        end = end == ryml::npos ? src_.len : end;
+        //text outside the root element is ignored
+        if(!stack_.empty() && !stack_.back().parent && !append(stack_.back(), pos_, end, false)) {
+          return false;
+        }
+        pos_ = end;
+      } else if(src_.sub(pos_).begins_with("<?")) {
+        if(!skip_past("?>")) {
+          return false;
+        }
+      } else if(src_.sub(pos_).begins_with("<!--")) {
+        if(!skip_past("-->")) {
+          return false;
+        }
+      } else if(src_.sub(pos_).begins_with("<![CDATA[")) {
+        size_t from = pos_ + 9;
+        if(!skip_past("]]>")) {
+          return false;
+        }
+        if(!stack_.empty() && !stack_.back().parent) {
+          append(stack_.back(), from, pos_ - 3, true);
+        }
+      } else if(src_.sub(pos_).begins_with("<!")) {
+        //a doctype, without internal subset
+        if(!skip_past(">")) {
+          return false;
+        }
+      } else if(src_.sub(pos_).begins_with("</")) {
+        if(!close()) {
+          return false;
+        }
+      } else if(!open()) {
+        return false;
+      }
+    }
+    if(!root_seen_) {
+      error_ = ERR_XML_NO_ROOT;
+      return false;
+    }
+    if(!stack_.empty()) {
+      error_ = ERR_XML_UNCLOSED;
+      return false;
+    }
+    return true;
+  }
+
+  bool skip_past(ryml::csubstr marker) {
+    size_t at = src_.find(marker, pos_);
+    if(at == ryml::npos) {
+      error_ = ERR_XML_MARKUP;
+      return false;
+    }
+    pos_ = at + marker.len;
+    return true;
+  }
+
+  static bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+  }
+
+  bool open() {
+    size_t from = ++pos_;
+    while(pos_ < src_.len && !is_space(src_[pos_]) && src_[pos_] != '/' && src_[pos_] != '>') {
+      ++pos_;
+    }
+    ryml::csubstr name = src_.sub(from, pos_ - from);
+
+    //attributes are skipped, minding quoted values
+    char quote = 0;
+    for(; pos_ < src_.len; ++pos_) {
+      char c = src_[pos_];
+      if(quote) {
+        quote = c == quote ? 0 : quote;
+      } else if(c == '"' || c == '\'') {
+        quote = c;
+      } else if(c == '>') {
+        break;
+      }
+    }
+    if(name.empty() || pos_ >= src_.len) {
+      error_ = ERR_XML_MARKUP;
+      return false;
+    }
+    bool empty = src_[pos_ - 1] == '/';
+    ++pos_;
+
+    if(stack_.empty()) {
+      if(root_seen_) {
+        error_ = ERR_XML_MARKUP;
+        return false;
+      }
+      root_seen_ = true;
+      stack_.push_back({root_, name});
+    } else {
+      if(stack_.size() >= MAX_DEPTH) {
+        error_ = ERR_TOO_DEEP;
+        return false;
+      }
+      size_t id = child(stack_.back(), name);
+      stack_.push_back({id, name});
+    }
+    if(empty) {
+      close_top();
+    }
+    return true;
+  }
+
+  bool close() {
+    size_t from = pos_ + 2;
+    if(!skip_past(">")) {
+      return false;
+    }
+    ryml::csubstr name = src_.sub(from, pos_ - 1 - from).trimr(" \t\r\n");
+    if(stack_.empty() || stack_.back().name != name) {
+      error_ = ERR_XML_MISMATCH;
+      return false;
+    }
+    close_top();
+    return true;
+  }
+
+  //the node of a child element named name of p
+  size_t child(frame &p, ryml::csubstr name) {
+    if(!p.parent) {
+      p.parent = true;
+      if(t_.has_key(p.id)) {
+        t_.to_map(p.id, t_.key(p.id));
+      } else {
+        t_.to_map(p.id);
+      }
+    }
+
+    size_t prev = ryml::NONE;
+    if(p.last != ryml::NONE && t_.key(p.last) == name) {
+      prev = p.last;
+    } else {
+      prev = t_.find_child(p.id, name);
+    }
+
+    size_t id;
+    if(prev == ryml::NONE) {
+      id = t_.append_child(p.id);
+      t_.to_keyval(id, name, ryml::csubstr{});
+      p.last = id;
+      return id;
+    }
+
+    //the first repetition turns the sibling into the sequence of the occurrences
+    if(!t_.is_seq(prev)) {
+      size_t seq = t_.insert_child(p.id, prev);
+      t_.to_seq(seq, name);
+      ryml::NodeRef(&t_, prev).clear_key();
+      t_.move(prev, seq, ryml::NONE);
+      prev = seq;
+    }
+    id = t_.append_child(prev);
+    t_.to_val(id, ryml::csubstr{});
+    p.last = prev;
+    return id;
+  }
+
+  void close_top() {
+    frame &f = stack_.back();
+    if(!f.parent) {
+      //an empty element is an empty string, not a null;
+      //xml text has no type, so it is quoted: 0001 stays a string, as large ids do
+      ryml::csubstr text(f.text ? f.text : src_.str, f.text_len);
+      if(t_.has_key(f.id)) {
+        t_.to_keyval(f.id, t_.key(f.id), text);
+      } else {
+        t_.to_val(f.id, text);
+      }
+      ryml::NodeRef(&t_, f.id) |= ryml::VALQUO;
+    }
+    stack_.pop_back();
+  }
+
+  //appends the text in [from, to) to f, decoding the entities unless raw;
+  //the decoded text is never longer, so it is written over what was read
+  bool append(frame &f, size_t from, size_t to, bool raw) {
+    if(!f.text) {
+      f.text = src_.str + from;
+    }
+    char *w = f.text + f.text_len;
+    for(size_t r = from; r < to;) {
+      char c = src_[r];
+      if(raw || c != '&') {
+        *w++ = c;
+        ++r;
+        continue;
+      }
+      size_t semi = src_.find(';', r);
+      if(semi == ryml::npos || semi >= to) {
+        error_ = ERR_XML_ENTITY;
+        return false;
+      }
+      ryml::csubstr ent = src_.sub(r + 1, semi - r - 1);
+      if(ent == "lt") {
+        *w++ = '<';
+      } else if(ent == "gt") {
+        *w++ = '>';
+      } else if(ent == "amp") {
+        *w++ = '&';
+      } else if(ent == "quot") {
+        *w++ = '"';
+      } else if(ent == "apos") {
+        *w++ = '\'';
+      } else if(ent.begins_with('#') && ent.len > 1) {
+        bool hex = ent[1] == 'x' || ent[1] == 'X';
+        ryml::csubstr digits = ent.sub(hex ? 2 : 1);
+        uint32_t cp = 0;
+        auto conv = std::from_chars(digits.begin(), digits.end(), cp, hex ? 16 : 10);
+        if(digits.empty() || conv.ptr != digits.end() || conv.ec != std::errc() || cp > 0x10ffff) {
+          error_ = ERR_XML_ENTITY;
+          return false;
+        }
+        w = put_utf8(w, cp);
+      } else {
+        error_ = ERR_XML_ENTITY;
+        return false;
+      }
+      r = semi + 1;
+    }
+    f.text_len = (size_t)(w - f.text);
+    return true;
+  }
+
+  static char *put_utf8(char *w, uint32_t cp) {
+    if(cp < 0x80) {
+      *w++ = (char)cp;
+    } else if(cp < 0x800) {
+      *w++ = (char)(0xc0 | (cp >> 6));
+      *w++ = (char)(0x80 | (cp & 0x3f));
+    } else if(cp < 0x10000) {
+      *w++ = (char)(0xe0 | (cp >> 12));
+      *w++ = (char)(0x80 | ((cp >> 6) & 0x3f));
+      *w++ = (char)(0x80 | (cp & 0x3f));
+    } else {
+      *w++ = (char)(0xf0 | (cp >> 18));
+      *w++ = (char)(0x80 | ((cp >> 12) & 0x3f));
+      *w++ = (char)(0x80 | ((cp >> 6) & 0x3f));
+      *w++ = (char)(0x80 | (cp & 0x3f));
+    }
+    return w;
+  }
+
+  ryml::Tree &t_;
+  size_t root_;
+  ryml::substr src_;
+  std::string &error_;
+  size_t pos_ = 0;
+  bool root_seen_ = false;
+  std::vector<frame> stack_;
+};
+
+}
+
+bool decode_xml(ryml::csubstr in,
+                ryml::NodeRef to,
+                std::string &error)
+{
+  ryml::Tree &t = *to.tree();
+
+  //the only copy of the input, parsed in place
+  ryml::substr src = t.alloc_arena(in.len);
+  memcpy(src.str, in.str, in.len);
+
+  xml_parser parser{t, to.id(), src, error};
+  return parser.parse();
+}
+
+}
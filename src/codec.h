@@ -0,0 +1,46 @@
+#pragma once
+#include "utils.h"
+
+namespace codec {
+
+// ---------------------
+// --- BINARY FORMAT ---
+// ---------------------
+
+enum format {
+  //RFC 8949
+  cbor,
+  msgpack
+};
+
+std::optional<format> format_from(const std::string &name);
+
+//appends the encoding of the subtree at id to out: maps, sequences
+//and scalars typed as utils::scalar_kind_of reads them
+void encode(const ryml::Tree &t,
+            size_t id,
+            format fmt,
+            std::string &out);
+
+//decodes the item at pos into to, advancing pos past it;
+//returns false and sets error when the input is malformed
+bool decode(std::string_view in,
+            size_t &pos,
+            format fmt,
+            ryml::NodeRef to,
+            std::string &error);
+
+// -----------
+// --- XML ---
+// -----------
+
+//parses an xml document into to, without an intermediate DOM: the children
+//of the root element become the children of to, repeated siblings a sequence,
+//attributes are dropped; the input is copied once into to's arena,
+//which the keys and the decoded text point into.
+//returns false and sets error when the input is malformed
+bool decode_xml(ryml::csubstr in,
+                ryml::NodeRef to,
+                std::string &error);
+
+}
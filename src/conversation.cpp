@@ -1,8 +1,10 @@
-#include "request.h"
+#include "replay.h"
 
-#define ERR_FAIL_RESET_CONV   "failed to reset conversation"
-#define ERR_FAIL_READ_HOST    "failed to read 'host'"
-#define ERR_REQ_NOT_SEQ       "'requests' is not a sequence"
+#define ERR_FAIL_RESET_CONV     "failed to reset conversation"
+#define ERR_FAIL_READ_HOST      "failed to read 'host'"
+#define ERR_REQ_NOT_SEQ         "'requests' is not a sequence"
+#define ERR_FAIL_READ_THROTTLE  "failed to read 'throttle'"
+#define ERR_BAD_RATE            "bad rate"
 
 namespace cbox {
 
@@ -14,6 +16,7 @@ void conversation::statistics::reset()
 {
   request_count_ = 0;
   categorization_.clear();
+  connections_.clear();
 }
 
 void conversation::statistics::incr_request_count()
@@ -21,12 +24,18 @@ void conversation::statistics::incr_request_count()
   ++request_count_;
 }
 
-void conversation::statistics::incr_categorization(const std::string &key)
+void conversation::statistics::incr_categorization(utils::interner::handle key)
 {
   auto value = categorization_[key];
   categorization_[key] = ++value;
 }
 
+void conversation::statistics::record_connection(const std::string &host,
+                                                 const utils::conn_stats &event)
+{
+  connections_[host].merge(event);
+}
+
 // --------------------
 // --- CONVERSATION ---
 // --------------------
@@ -35,6 +44,7 @@ conversation::conversation(scenario &parent) :
   parent_(parent),
   scen_out_p_resolv_(parent_.scen_out_p_resolv_),
   scen_p_evaluator_(parent_.scen_p_evaluator_),
+  interner_(parent_.interner_),
   indexed_nodes_map_(parent_.indexed_nodes_map_),
   js_env_(parent.js_env_),
   stats_(*this),
@@ -47,6 +57,7 @@ int conversation::reset(ryml::NodeRef conversation_in)
 {
   // reset stats
   stats_.reset();
+  throttle_ = utils::throttle();
   return 0;
 }
 
@@ -75,6 +86,10 @@ int conversation::process(ryml::NodeRef conversation_in,
     if(scope.enabled_) {
       parent_.stats_.incr_conversation_count();
 
+      if(parent_.ctx_.cfg_.out_format == STR_NDJSON) {
+        idx_ = (uint32_t)conversation_out.parent().child_pos(conversation_out);
+      }
+
       //id
       bool further_eval = false;
       auto id = js_env_.eval_as<std::string>(conversation_out,
@@ -82,7 +97,7 @@ int conversation::process(ryml::NodeRef conversation_in,
                                              std::nullopt,
                                              true,
                                              nullptr,
-                                             PROP_EVAL_RGX,
+                                             true,
                                              &further_eval);
       if(!id) {
         if(further_eval) {
@@ -92,7 +107,8 @@ int conversation::process(ryml::NodeRef conversation_in,
         }
       }
       if(id) {
-        indexed_nodes_map_[*id] = conversation_out;
+        indexed_nodes_map_[interner_.intern(*id)] = conversation_out;
+        has_id_ = true;
       }
 
       further_eval = false;
@@ -101,7 +117,7 @@ int conversation::process(ryml::NodeRef conversation_in,
                                                    std::nullopt,
                                                    true,
                                                    nullptr,
-                                                   PROP_EVAL_RGX,
+                                                   true,
                                                    &further_eval);
       if(!raw_host) {
         if(further_eval) {
@@ -134,7 +150,7 @@ int conversation::process(ryml::NodeRef conversation_in,
                                                     "s3",
                                                     true,
                                                     nullptr,
-                                                    PROP_EVAL_RGX,
+                                                    true,
                                                     &further_eval);
 
         if(further_eval) {
@@ -161,7 +177,7 @@ int conversation::process(ryml::NodeRef conversation_in,
                                                        std::nullopt,
                                                        true,
                                                        nullptr,
-                                                       PROP_EVAL_RGX,
+                                                       true,
                                                        &further_eval);
         if(further_eval) {
           access_key = scen_p_evaluator_.eval_as<std::string>(conversation_out,
@@ -185,7 +201,7 @@ int conversation::process(ryml::NodeRef conversation_in,
                                                        std::nullopt,
                                                        true,
                                                        nullptr,
-                                                       PROP_EVAL_RGX,
+                                                       true,
                                                        &further_eval);
         if(further_eval) {
           secret_key = scen_p_evaluator_.eval_as<std::string>(conversation_out,
@@ -209,7 +225,7 @@ int conversation::process(ryml::NodeRef conversation_in,
                                                            AUTH_AWS_DEF_SIGN_HDRS,
                                                            true,
                                                            nullptr,
-                                                           PROP_EVAL_RGX,
+                                                           true,
                                                            &further_eval);
         if(further_eval) {
           signed_headers = scen_p_evaluator_.eval_as<std::string>(conversation_out,
@@ -234,7 +250,7 @@ int conversation::process(ryml::NodeRef conversation_in,
                                                    "US",
                                                    true,
                                                    nullptr,
-                                                   PROP_EVAL_RGX,
+                                                   true,
                                                    &further_eval);
 
         if(further_eval) {
@@ -262,31 +278,52 @@ int conversation::process(ryml::NodeRef conversation_in,
                     *region);
       }
 
-      if(conversation_in.has_child(key_requests)) {
-        ryml::NodeRef requests_in = conversation_in[key_requests];
-        if(!requests_in.is_seq()) {
-          res = 1;
-          event_log_->error(ERR_REQ_NOT_SEQ);
-          utils::clear_map_node_put_key_val(conversation_out, key_error, ERR_REQ_NOT_SEQ);
-          goto fun_end;
+      //throttle
+      if(conversation_out.has_child(key_throttle)) {
+        if(read_throttle(conversation_out[key_throttle], throttle_)) {
+          event_log_->error(ERR_FAIL_READ_THROTTLE);
+          utils::clear_map_node_put_key_val(conversation_out, key_error, ERR_FAIL_READ_THROTTLE);
+          return 1;
         }
+      }
 
+      if(conversation_in.has_child(key_requests) || conversation_in.has_child(key_replay)) {
         ryml::NodeRef requests_out = conversation_out[key_requests];
         requests_out |= ryml::SEQ;
         requests_out.clear_children();
+        scen_out_p_resolv_.requests_cleared();
+
+        if(conversation_in.has_child(key_requests)) {
+          ryml::NodeRef requests_in = conversation_in[key_requests];
+          if(!requests_in.is_seq()) {
+            res = 1;
+            event_log_->error(ERR_REQ_NOT_SEQ);
+            utils::clear_map_node_put_key_val(conversation_out, key_error, ERR_REQ_NOT_SEQ);
+            goto fun_end;
+          }
 
-        //requests cycle
-        for(ryml::NodeRef const &request_in : requests_in.children()) {
+          //requests cycle
+          for(ryml::NodeRef const &request_in : requests_in.children()) {
 
-          /*TODO parallel handling*/
-          request req(*this);
+            /*TODO parallel handling*/
+            request req(*this);
 
-          if((res = req.process(raw_host_,
-                                request_in,
-                                requests_out))) {
-            break;
+            if((res = req.process(raw_host_,
+                                  request_in,
+                                  requests_out))) {
+              break;
+            }
           }
         }
+
+        //replay of a recorded request log
+        if(!res && conversation_in.has_child(key_replay)) {
+          replay rpl(*this);
+
+          res = rpl.process(raw_host_,
+                            conversation_in[key_replay],
+                            requests_out);
+        }
       }
       if(!res) {
         enrich_with_stats(conversation_out);
@@ -312,9 +349,35 @@ void conversation::enrich_with_stats(ryml::NodeRef conversation_out)
   ryml::NodeRef res_code_categorization = statistics[key_categorization];
   res_code_categorization |= ryml::MAP;
   std::for_each(stats_.categorization_.begin(), stats_.categorization_.end(), [&](const auto &it) {
-    ryml::csubstr code = res_code_categorization.to_arena(it.first);
+    ryml::csubstr code = res_code_categorization.to_arena(interner_.str(it.first));
     res_code_categorization[code] << it.second;
   });
+  utils::put_conn_stats(statistics, stats_.connections_);
+}
+
+int conversation::read_throttle(ryml::NodeRef throttle_in,
+                                utils::throttle &throttle)
+{
+  auto upload = js_env_.eval_as<std::string>(throttle_in, key_upload);
+  if(upload) {
+    auto rate = utils::parse_rate(*upload);
+    if(!rate) {
+      event_log_->error("{}:{}", ERR_BAD_RATE, *upload);
+      return 1;
+    }
+    throttle.upload = *rate;
+  }
+
+  auto download = js_env_.eval_as<std::string>(throttle_in, key_download);
+  if(download) {
+    auto rate = utils::parse_rate(*download);
+    if(!rate) {
+      event_log_->error("{}:{}", ERR_BAD_RATE, *download);
+      return 1;
+    }
+    throttle.download = *rate;
+  }
+  return 0;
 }
 
 }
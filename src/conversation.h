@@ -16,13 +16,17 @@ struct conversation {
 
         void reset();
         void incr_request_count();
-        void incr_categorization(const std::string &key);
+        void incr_categorization(utils::interner::handle key);
+        void record_connection(const std::string &host, const utils::conn_stats &event);
 
         conversation &parent_;
 
       private:
         uint32_t request_count_ = 0;
-        std::unordered_map<std::string, int32_t> categorization_;
+        std::unordered_map<utils::interner::handle, int32_t> categorization_;
+
+        //connection counters per host
+        std::unordered_map<std::string, utils::conn_stats> connections_;
     };
 
     conversation(scenario &parent);
@@ -40,6 +44,9 @@ struct conversation {
 
     void enrich_with_stats(ryml::NodeRef conversation_out);
 
+    int read_throttle(ryml::NodeRef throttle_in,
+                      utils::throttle &throttle);
+
     // -----------
     // --- REP ---
     // -----------
@@ -54,8 +61,11 @@ struct conversation {
     //scenario property evaluator
     scenario_property_evaluator &scen_p_evaluator_;
 
-    //map holding nodes with an explicit id set
-    std::unordered_map<std::string, ryml::ConstNodeRef> &indexed_nodes_map_;
+    //ids and category keys
+    utils::interner &interner_;
+
+    //map holding nodes with an explicit id set, by interned id
+    std::unordered_map<utils::interner::handle, ryml::ConstNodeRef> &indexed_nodes_map_;
 
     //js environment
     js::js_env &js_env_;
@@ -66,9 +76,19 @@ struct conversation {
     //conversation context
     std::string raw_host_;
 
+    //the conversation has an id, so its requests can be read back through it
+    bool has_id_ = false;
+
+    //the index of the conversation in the scenario, and of its next request event
+    uint32_t idx_ = 0;
+    uint32_t event_idx_ = 0;
+
     //aws auth
     utils::aws_auth auth_;
 
+    //bandwidth throttling
+    utils::throttle throttle_;
+
     //event logger
     std::shared_ptr<spdlog::logger> event_log_;
 };
@@ -56,7 +56,7 @@ void endpoint::do_put_document(const Pistache::Rest::Request &request,
     return;
   }
 
-  cbox::context ctx(env_.cfg_, &response);
+  cbox::context ctx(env_.cfg_, env_.out_hint_, &response);
   if((res = ctx.init(event_log_))) {
     return;
   }
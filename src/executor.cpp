@@ -0,0 +1,144 @@
+#include "executor.h"
+
+#define ERR_FAIL_INIT_SHARD   "failed to init scenario shard"
+#define ERR_FAIL_RESET_SHARD  "failed to reset scenario shard"
+#define ERR_CONV_NOT_RUN      "not run, a previous conversation failed"
+
+namespace cbox {
+
+// --------------
+// --- WORKER ---
+// --------------
+
+executor::worker::worker(executor &parent, uint32_t idx) :
+  parent_(parent),
+  idx_(idx)
+{}
+
+void executor::worker::run(const std::function<int(worker &)> &job)
+{
+  scenario &parent_scenario = parent_.parent_;
+
+  //the shard, and so its V8 isolate, lives and dies within this thread
+  shard_.reset(new scenario(parent_scenario.ctx_));
+  if((res_ = shard_->init(parent_scenario.event_log_))) {
+    parent_.event_log_->error(ERR_FAIL_INIT_SHARD);
+    shard_.reset();
+    parent_.ready_->count_down();
+    return;
+  }
+
+  utils::set_tree_node(*parent_scenario.scenario_in_root_.tree(),
+                       parent_scenario.scenario_in_root_,
+                       doc_in_.rootref(),
+                       ryml_worker_buf_);
+
+  if((res_ = shard_->reset(doc_in_, doc_in_.rootref()))) {
+    parent_.event_log_->error(ERR_FAIL_RESET_SHARD);
+    shard_.reset();
+    parent_.ready_->count_down();
+    return;
+  }
+
+  parent_.ready_->arrive_and_wait();
+  res_ = job(*this);
+  shard_.reset();
+}
+
+// ----------------
+// --- EXECUTOR ---
+// ----------------
+
+executor::executor(scenario &parent) :
+  parent_(parent),
+  event_log_(parent.event_log_)
+{}
+
+uint32_t executor::concurrency(uint32_t requested)
+{
+  if(requested) {
+    return requested;
+  }
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+int executor::process_conversations(ryml::NodeRef conversations_in,
+                                    ryml::NodeRef conversations_out)
+{
+  const uint32_t conv_count = (uint32_t)conversations_in.num_children();
+  const uint32_t workers = std::min(concurrency(parent_.ctx_.cfg_.workers), conv_count);
+
+  event_log_->debug("sharding {} conversations across {} workers", conv_count, workers);
+
+  return run(workers, [&](worker &w) -> int {
+    int res = 0;
+    ryml::NodeRef shard_conversations_in = w.doc_in_.rootref()[key_conversations];
+    ryml::NodeRef shard_conversations_out = w.shard_->scenario_out_.rootref()[key_conversations];
+
+    //conversations are sharded round-robin and keep their natural index;
+    //conversations before run_end have run, the failed one included
+    uint32_t run_end = w.idx_;
+    for(; run_end < conv_count && !stop_; run_end += workers) {
+      conversation conv(*w.shard_);
+
+      if((res = conv.process(shard_conversations_in[run_end],
+                             shard_conversations_out[run_end]))) {
+        stop_ = true;
+        run_end += workers;
+        break;
+      }
+    }
+
+    //merge the shard into the parent scenario
+    std::lock_guard<std::mutex> lock(merge_mtx_);
+    for(uint32_t conv_it = w.idx_; conv_it < conv_count; conv_it += workers) {
+      ryml::NodeRef conversation_out = conversations_out[conv_it];
+      //a conversation left out by a failure stays as its input, marked
+      if(conv_it >= run_end) {
+        if(conversation_out.has_child(key_error)) {
+          conversation_out.remove_child(key_error);
+        }
+        conversation_out[key_error] << ERR_CONV_NOT_RUN;
+        continue;
+      }
+      conversation_out.clear_children();
+      parent_.scen_out_p_resolv_.requests_cleared();
+      utils::set_tree_node(w.shard_->scenario_out_,
+                           shard_conversations_out[conv_it],
+                           conversation_out,
+                           parent_.ryml_scenario_out_buf_);
+    }
+    parent_.stats_.merge(w.shard_->stats_);
+    return res;
+  });
+}
+
+int executor::run(uint32_t workers,
+                  const std::function<int(worker &)> &job)
+{
+  int res = 0;
+  std::vector<std::unique_ptr<worker>> pool;
+  std::latch ready(workers);
+  ready_ = &ready;
+
+  //the ryml error handler is pinned for the whole run, since callbacks are process-wide
+  parent_.ctx_.REH_.pin();
+
+  for(uint32_t i = 0; i < workers; ++i) {
+    pool.emplace_back(new worker(*this, i));
+    pool.back()->thread_ = std::thread(&worker::run, pool.back().get(), std::cref(job));
+  }
+
+  for(auto &w : pool) {
+    w->thread_.join();
+    if(w->res_) {
+      res = w->res_;
+    }
+  }
+
+  ready_ = nullptr;
+  parent_.ctx_.REH_.unpin();
+  return res;
+}
+
+}
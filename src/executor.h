@@ -0,0 +1,64 @@
+#pragma once
+#include "replay.h"
+#include <latch>
+
+namespace cbox {
+
+struct executor {
+
+    // --------------
+    // --- WORKER ---
+    // --------------
+
+    struct worker {
+
+        worker(executor &parent, uint32_t idx);
+
+        void run(const std::function<int(worker &)> &job);
+
+        //parent
+        executor &parent_;
+
+        //worker index
+        uint32_t idx_;
+
+        //private copy of the scenario-in
+        ryml::Tree doc_in_;
+
+        //ryml worker support buffer
+        std::vector<char> ryml_worker_buf_;
+
+        //scenario shard: own js_env, connection pool and statistics
+        std::unique_ptr<scenario> shard_;
+
+        std::thread thread_;
+        int res_ = 0;
+    };
+
+    executor(scenario &parent);
+
+    static uint32_t concurrency(uint32_t requested);
+
+    int process_conversations(ryml::NodeRef conversations_in,
+                              ryml::NodeRef conversations_out);
+
+    int run(uint32_t workers,
+            const std::function<int(worker &)> &job);
+
+    //parent
+    scenario &parent_;
+
+    //serializes the merge of the shards into the parent
+    std::mutex merge_mtx_;
+
+    //releases the jobs together, once every shard is ready (or failed)
+    std::latch *ready_ = nullptr;
+
+    //set at the first failed conversation: all the workers stop, as a sequential run would
+    std::atomic<bool> stop_ = false;
+
+    //event logger
+    std::shared_ptr<spdlog::logger> event_log_;
+};
+
+}
@@ -0,0 +1,518 @@
+#include "expr.h"
+
+#define ERR_UNEXPECTED_END      "unexpected end of expression"
+#define ERR_UNEXPECTED_CHAR     "unexpected character"
+#define ERR_UNKNOWN_IDENT       "unknown identifier"
+#define ERR_BAD_ARGS            "bad arguments"
+#define ERR_UNTERMINATED_STR    "unterminated string"
+#define ERR_UNRESOLVED_REF      "unresolved reference"
+
+namespace cbox {
+
+// -------------
+// --- VALUE ---
+// -------------
+
+double expression::value::as_number() const
+{
+  switch(kind_) {
+    case string: {
+      std::string_view str(str_);
+      size_t first = str.find_first_not_of(" \t"), last = str.find_last_not_of(" \t");
+      auto res = first == std::string_view::npos ? std::nullopt :
+                 utils::parse<double>(str.substr(first, last - first + 1));
+      return res ? *res : std::nan("");
+    }
+    default:
+      return num_;
+  }
+}
+
+std::string expression::value::as_string() const
+{
+  switch(kind_) {
+    case string:
+      return str_;
+    case boolean:
+      return num_ ? STR_TRUE : STR_FALSE;
+    default:
+      //integral values are rendered without the fractional part
+      if(std::isfinite(num_) && num_ == std::trunc(num_) && std::fabs(num_) < 9007199254740992.0) {
+        return utils::to_str((int64_t)num_);
+      }
+      return utils::to_str(num_);
+  }
+}
+
+bool expression::value::truthy() const
+{
+  switch(kind_) {
+    case string:
+      return !str_.empty();
+    default:
+      return num_ != 0 && !std::isnan(num_);
+  }
+}
+
+// --------------
+// --- PARSER ---
+// --------------
+
+//recursive descent, lowest precedence first:
+//cond: lor ('?' cond ':' cond)?
+//lor: land ('||' land)*
+//land: equality ('&&' equality)*
+//equality: relational (('=='|'!=') relational)*
+//relational: additive (('<'|'<='|'>'|'>=') additive)*
+//additive: multiplicative (('+'|'-') multiplicative)*
+//multiplicative: unary (('*'|'/'|'%') unary)*
+//unary: ('-'|'!') unary | primary
+//primary: number | string | true | false | i | call | '(' cond ')'
+struct expr_parser {
+
+  expr_parser(std::string_view source,
+              std::vector<expression::node> &nodes,
+              std::string &error) :
+    src_(source),
+    nodes_(nodes),
+    error_(error) {}
+
+  int32_t fail(const char *msg) {
+    if(error_.empty()) {
+      error_ = pos_ < src_.size() ? fmt::format("{} at {}", msg, pos_) : msg;
+    }
+    return -1;
+  }
+
+  void skip_ws() {
+    while(pos_ < src_.size() && std::isspace((unsigned char)src_[pos_])) {
+      ++pos_;
+    }
+  }
+
+  bool accept(std::string_view tok) {
+    skip_ws();
+    if(src_.substr(pos_, tok.size()) == tok) {
+      pos_ += tok.size();
+      return true;
+    }
+    return false;
+  }
+
+  int32_t push(expression::op op, int32_t a = -1, int32_t b = -1, int32_t c = -1) {
+    expression::node n;
+    n.op_ = op;
+    n.a_ = a;
+    n.b_ = b;
+    n.c_ = c;
+    nodes_.push_back(std::move(n));
+    return (int32_t)nodes_.size() - 1;
+  }
+
+  int32_t push_lit(expression::value &&val) {
+    int32_t n = push(expression::lit);
+    nodes_[n].val_ = std::move(val);
+    return n;
+  }
+
+  int32_t parse_cond() {
+    int32_t c = parse_lor();
+    if(c < 0 || !accept("?")) {
+      return c;
+    }
+    int32_t a = parse_cond();
+    if(a < 0) {
+      return -1;
+    }
+    if(!accept(":")) {
+      return fail(pos_ < src_.size() ? ERR_UNEXPECTED_CHAR : ERR_UNEXPECTED_END);
+    }
+    int32_t b = parse_cond();
+    if(b < 0) {
+      return -1;
+    }
+    return push(expression::cond, c, a, b);
+  }
+
+  int32_t parse_lor() {
+    int32_t a = parse_land();
+    while(a >= 0 && accept("||")) {
+      int32_t b = parse_land();
+      a = b < 0 ? -1 : push(expression::lor, a, b);
+    }
+    return a;
+  }
+
+  int32_t parse_land() {
+    int32_t a = parse_equality();
+    while(a >= 0 && accept("&&")) {
+      int32_t b = parse_equality();
+      a = b < 0 ? -1 : push(expression::land, a, b);
+    }
+    return a;
+  }
+
+  int32_t parse_equality() {
+    int32_t a = parse_relational();
+    while(a >= 0) {
+      expression::op op;
+      if(accept("==")) {
+        op = expression::eq;
+      } else if(accept("!=")) {
+        op = expression::ne;
+      } else {
+        break;
+      }
+      int32_t b = parse_relational();
+      a = b < 0 ? -1 : push(op, a, b);
+    }
+    return a;
+  }
+
+  int32_t parse_relational() {
+    int32_t a = parse_additive();
+    while(a >= 0) {
+      expression::op op;
+      if(accept("<=")) {
+        op = expression::le;
+      } else if(accept(">=")) {
+        op = expression::ge;
+      } else if(accept("<")) {
+        op = expression::lt;
+      } else if(accept(">")) {
+        op = expression::gt;
+      } else {
+        break;
+      }
+      int32_t b = parse_additive();
+      a = b < 0 ? -1 : push(op, a, b);
+    }
+    return a;
+  }
+
+  int32_t parse_additive() {
+    int32_t a = parse_multiplicative();
+    while(a >= 0) {
+      expression::op op;
+      if(accept("+")) {
+        op = expression::add;
+      } else if(accept("-")) {
+        op = expression::sub;
+      } else {
+        break;
+      }
+      int32_t b = parse_multiplicative();
+      a = b < 0 ? -1 : push(op, a, b);
+    }
+    return a;
+  }
+
+  int32_t parse_multiplicative() {
+    int32_t a = parse_unary();
+    while(a >= 0) {
+      expression::op op;
+      if(accept("*")) {
+        op = expression::mul;
+      } else if(accept("/")) {
+        op = expression::div;
+      } else if(accept("%")) {
+        op = expression::mod;
+      } else {
+        break;
+      }
+      int32_t b = parse_unary();
+      a = b < 0 ? -1 : push(op, a, b);
+    }
+    return a;
+  }
+
+  int32_t parse_unary() {
+    if(accept("-")) {
+      int32_t a = parse_unary();
+      return a < 0 ? -1 : push(expression::neg, a);
+    }
+    //'!' but not '!='
+    skip_ws();
+    if(src_.substr(pos_, 1) == "!" && src_.substr(pos_, 2) != "!=") {
+      ++pos_;
+      int32_t a = parse_unary();
+      return a < 0 ? -1 : push(expression::lnot, a);
+    }
+    return parse_primary();
+  }
+
+  int32_t parse_primary() {
+    skip_ws();
+    if(pos_ >= src_.size()) {
+      return fail(ERR_UNEXPECTED_END);
+    }
+    char c = src_[pos_];
+
+    if(c == '(') {
+      ++pos_;
+      int32_t a = parse_cond();
+      if(a < 0) {
+        return -1;
+      }
+      if(!accept(")")) {
+        return fail(pos_ < src_.size() ? ERR_UNEXPECTED_CHAR : ERR_UNEXPECTED_END);
+      }
+      return a;
+    }
+
+    if(c == '\'' || c == '"') {
+      size_t end = src_.find(c, pos_ + 1);
+      if(end == std::string_view::npos) {
+        return fail(ERR_UNTERMINATED_STR);
+      }
+      expression::value val;
+      val.kind_ = expression::value::string;
+      val.str_ = src_.substr(pos_ + 1, end - pos_ - 1);
+      pos_ = end + 1;
+      return push_lit(std::move(val));
+    }
+
+    if(std::isdigit((unsigned char)c) || c == '.') {
+      size_t end = pos_;
+      while(end < src_.size() && (std::isalnum((unsigned char)src_[end]) || src_[end] == '.' ||
+                                  ((src_[end] == '+' || src_[end] == '-') && (src_[end - 1] == 'e' || src_[end - 1] == 'E')))) {
+        ++end;
+      }
+      auto num = utils::parse<double>(src_.substr(pos_, end - pos_));
+      if(!num) {
+        return fail(ERR_UNEXPECTED_CHAR);
+      }
+      pos_ = end;
+      expression::value val;
+      val.num_ = *num;
+      return push_lit(std::move(val));
+    }
+
+    if(std::isalpha((unsigned char)c) || c == '_') {
+      size_t end = pos_;
+      while(end < src_.size() && (std::isalnum((unsigned char)src_[end]) || src_[end] == '_')) {
+        ++end;
+      }
+      std::string_view ident = src_.substr(pos_, end - pos_);
+      pos_ = end;
+
+      if(ident == "true" || ident == "false") {
+        expression::value val;
+        val.kind_ = expression::value::boolean;
+        val.num_ = ident == "true";
+        return push_lit(std::move(val));
+      }
+      if(ident == "i") {
+        return push(expression::iter);
+      }
+
+      expression::op op;
+      if(ident == "rand") {
+        op = expression::rand;
+      } else if(ident == "now") {
+        op = expression::now;
+      } else if(ident == "ref") {
+        op = expression::ref;
+      } else {
+        pos_ -= ident.size();
+        return fail(ERR_UNKNOWN_IDENT);
+      }
+
+      if(!accept("(")) {
+        return fail(ERR_BAD_ARGS);
+      }
+      int32_t a = -1;
+      if(!accept(")")) {
+        if((a = parse_cond()) < 0) {
+          return -1;
+        }
+        if(!accept(")")) {
+          return fail(ERR_BAD_ARGS);
+        }
+      }
+      //rand takes an optional bound, ref a path, now nothing
+      if((op == expression::ref && a < 0) || (op == expression::now && a >= 0)) {
+        return fail(ERR_BAD_ARGS);
+      }
+      return push(op, a);
+    }
+
+    return fail(ERR_UNEXPECTED_CHAR);
+  }
+
+  std::string_view src_;
+  size_t pos_ = 0;
+  std::vector<expression::node> &nodes_;
+  std::string &error_;
+};
+
+// ------------------
+// --- EXPRESSION ---
+// ------------------
+
+bool expression::compile(std::string_view source,
+                         std::string &error)
+{
+  nodes_.clear();
+  error.clear();
+
+  expr_parser parser(source, nodes_, error);
+  root_ = parser.parse_cond();
+  if(root_ >= 0) {
+    parser.skip_ws();
+    if(parser.pos_ < source.size()) {
+      root_ = parser.fail(ERR_UNEXPECTED_CHAR);
+    }
+  }
+  if(root_ < 0) {
+    nodes_.clear();
+    return false;
+  }
+  return true;
+}
+
+bool expression::eval(const env &e,
+                      value &out,
+                      std::string &error) const
+{
+  if(root_ < 0) {
+    error = ERR_UNEXPECTED_END;
+    return false;
+  }
+  return eval(root_, e, out, error);
+}
+
+bool expression::eval(int32_t n,
+                      const env &e,
+                      value &out,
+                      std::string &error) const
+{
+  const node &nd = nodes_[n];
+  value a, b;
+
+  //short circuits first
+  switch(nd.op_) {
+    case land:
+    case lor:
+      if(!eval(nd.a_, e, out, error)) {
+        return false;
+      }
+      if(out.truthy() == (nd.op_ == lor)) {
+        return true;
+      }
+      return eval(nd.b_, e, out, error);
+    case cond:
+      if(!eval(nd.a_, e, a, error)) {
+        return false;
+      }
+      return eval(a.truthy() ? nd.b_ : nd.c_, e, out, error);
+    default:
+      break;
+  }
+
+  if(nd.a_ >= 0 && !eval(nd.a_, e, a, error)) {
+    return false;
+  }
+  if(nd.b_ >= 0 && !eval(nd.b_, e, b, error)) {
+    return false;
+  }
+
+  out.kind_ = value::number;
+  out.str_.clear();
+
+  //strings compare as strings, anything else as numbers
+  auto compare = [&]() -> double {
+    if(a.kind_ == value::string && b.kind_ == value::string) {
+      return a.str_.compare(b.str_);
+    }
+    double x = a.as_number(), y = b.as_number();
+    return x < y ? -1 : (x > y ? 1 : (x == y ? 0 : std::nan("")));
+  };
+  auto set_bool = [&](bool v) {
+    out.kind_ = value::boolean;
+    out.num_ = v;
+  };
+
+  switch(nd.op_) {
+    case lit:
+      out = nd.val_;
+      break;
+    case iter:
+      out.num_ = e.iteration;
+      break;
+    case rand:
+      if(nd.a_ < 0) {
+        out.num_ = std::uniform_real_distribution<double>(0, 1)(e.rng);
+      } else {
+        double bound = std::floor(a.as_number());
+        out.num_ = bound >= 1 ? std::floor(std::uniform_real_distribution<double>(0, bound)(e.rng)) : 0;
+      }
+      break;
+    case now:
+      out.num_ = (double)std::chrono::duration_cast<std::chrono::milliseconds>(
+                   std::chrono::system_clock::now().time_since_epoch()).count();
+      break;
+    case ref: {
+      std::string path = a.as_string();
+      auto res = e.ref ? e.ref(path) : std::nullopt;
+      if(!res) {
+        error = fmt::format("{}:{}", ERR_UNRESOLVED_REF, path);
+        return false;
+      }
+      out.kind_ = value::string;
+      out.str_ = std::move(*res);
+      break;
+    }
+    case neg:
+      out.num_ = -a.as_number();
+      break;
+    case lnot:
+      set_bool(!a.truthy());
+      break;
+    case add:
+      //concatenation as soon as one side is a string
+      if(a.kind_ == value::string || b.kind_ == value::string) {
+        out.kind_ = value::string;
+        out.str_ = a.as_string();
+        out.str_ += b.as_string();
+      } else {
+        out.num_ = a.as_number() + b.as_number();
+      }
+      break;
+    case sub:
+      out.num_ = a.as_number() - b.as_number();
+      break;
+    case mul:
+      out.num_ = a.as_number() * b.as_number();
+      break;
+    case div:
+      out.num_ = a.as_number() / b.as_number();
+      break;
+    case mod:
+      out.num_ = std::fmod(a.as_number(), b.as_number());
+      break;
+    case eq:
+      set_bool(compare() == 0);
+      break;
+    case ne:
+      set_bool(compare() != 0);
+      break;
+    case lt:
+      set_bool(compare() < 0);
+      break;
+    case le:
+      set_bool(compare() <= 0);
+      break;
+    case gt:
+      set_bool(compare() > 0);
+      break;
+    case ge:
+      set_bool(compare() >= 0);
+      break;
+    default:
+      break;
+  }
+  return true;
+}
+
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include <random>
+#include <functional>
+#include "utils.h"
+
+namespace cbox {
+
+// ------------------
+// --- EXPRESSION ---
+// ------------------
+
+//a small native expression language evaluated inside {{= ...}} templates,
+//covering the one-liners that would otherwise need a V8 round trip:
+//arithmetic (+ - * / %), string concatenation (+), comparisons,
+//logical operators (&& || !), the ternary operator,
+//the iteration index (i), rand(), rand(n), now() and ref(path).
+struct expression {
+
+  // -------------
+  // --- VALUE ---
+  // -------------
+
+  struct value {
+    enum kind {
+      number,
+      string,
+      boolean
+    };
+
+    kind kind_ = number;
+    double num_ = 0;
+    std::string str_;
+
+    double as_number() const;
+    std::string as_string() const;
+    bool truthy() const;
+  };
+
+  // -----------
+  // --- ENV ---
+  // -----------
+
+  struct env {
+    //the index of the current iteration of a request's 'for'
+    uint32_t iteration = 0;
+
+    std::mt19937_64 &rng;
+
+    //resolves a property path to its scalar value
+    std::function<std::optional<std::string>(const std::string &path)> ref;
+  };
+
+  enum op {
+    lit,
+    iter,
+    rand,
+    now,
+    ref,
+    neg,
+    lnot,
+    add,
+    sub,
+    mul,
+    div,
+    mod,
+    eq,
+    ne,
+    lt,
+    le,
+    gt,
+    ge,
+    land,
+    lor,
+    cond
+  };
+
+  struct node {
+    op op_;
+    value val_;
+    //operands, -1 when absent
+    int32_t a_ = -1, b_ = -1, c_ = -1;
+  };
+
+  //returns false and sets error when source is malformed
+  bool compile(std::string_view source,
+               std::string &error);
+
+  //returns false and sets error when the evaluation fails
+  bool eval(const env &e,
+            value &out,
+            std::string &error) const;
+
+  bool eval(int32_t n,
+            const env &e,
+            value &out,
+            std::string &error) const;
+
+  //nodes in a flat pool, operands are indexes into it
+  std::vector<node> nodes_;
+  int32_t root_ = -1;
+};
+
+}
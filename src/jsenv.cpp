@@ -206,9 +206,45 @@ bool js_env::js_value_from_ryml_noderef(ryml::NodeRef &obj_val,
   if(obj_val.is_val() && obj_val.val_is_null()) {
     js_obj_val = v8::Null(self.isolate_);
   } else if(obj_val.is_val() || obj_val.is_keyval()) {
-    js_obj_val = v8::String::NewFromUtf8(self.isolate_,
-                                         utils::converter<std::string>::asType(obj_val).c_str(),
-                                         v8::NewStringType::kNormal).ToLocalChecked();
+    //scalars reach JS with their type, quoted ones as strings;
+    //header values are strings whatever they read as
+    ryml::csubstr val = obj_val.val();
+    bool is_header = obj_val.is_keyval() &&
+                     obj_val.parent().has_key() &&
+                     obj_val.parent().key() == key_headers;
+    std::string_view num_str(val.str, val.len);
+    if(!num_str.empty() && num_str[0] == '+') {
+      num_str.remove_prefix(1);
+    }
+    utils::scalar_kind kind = is_header ? utils::scalar_string : utils::scalar_kind_of(obj_val);
+    //integers a double cannot hold exactly reach JS as their text:
+    //beyond 2^53, or too large even for int64 and so read as floats
+    if((kind == utils::scalar_int && !utils::is_safe_integer(utils::parse<int64_t>(num_str).value_or(0))) ||
+        (kind == utils::scalar_float && num_str.find_first_not_of("-0123456789") == std::string_view::npos)) {
+      kind = utils::scalar_string;
+    }
+    switch(kind) {
+      case utils::scalar_bool:
+        js_obj_val = v8::Boolean::New(self.isolate_, val == "true");
+        break;
+      case utils::scalar_int: {
+        int64_t num = utils::parse<int64_t>(num_str).value_or(0);
+        if(num >= INT32_MIN && num <= INT32_MAX) {
+          js_obj_val = v8::Integer::New(self.isolate_, (int32_t)num);
+        } else {
+          js_obj_val = v8::Number::New(self.isolate_, (double)num);
+        }
+        break;
+      }
+      case utils::scalar_float:
+        js_obj_val = v8::Number::New(self.isolate_, utils::parse<double>(num_str).value_or(0));
+        break;
+      default:
+        js_obj_val = v8::String::NewFromUtf8(self.isolate_,
+                                             val.str,
+                                             v8::NewStringType::kNormal,
+                                             (int)val.len).ToLocalChecked();
+    }
   } else if(obj_val.is_map() || obj_val.is_seq()) {
     js_obj_val = self.wrap_ryml_noderef(obj_val);
   } else {
@@ -237,6 +273,10 @@ bool js_env::ryml_noderef_from_js_value(ryml::NodeRef &obj_val,
     obj_val << utils::converter<double>::asType(js_obj_val, self.isolate_);
   } else if(js_obj_val->IsString()) {
     obj_val << utils::converter<std::string>::asType(js_obj_val, self.isolate_);
+    //a string that reads as another type is quoted, so it stays a string
+    if(utils::scalar_kind_of(obj_val) != utils::scalar_string) {
+      obj_val |= ryml::VALQUO;
+    }
   } else if(js_obj_val->IsBoolean()) {
     obj_val << utils::converter<bool>::asType(js_obj_val, self.isolate_);
   } else if(js_obj_val->IsArray()) {
@@ -14,20 +14,22 @@ struct converter;
 
 template <>
 struct converter<bool> {
+  static std::optional<bool> parse(std::string_view str) {
+    return utils::parse<bool>(str);
+  }
   static bool isType(ryml::ConstNodeRef val) {
     if(!val.is_keyval() && !val.is_val()) {
       return false;
     }
-    //@todo
-    return true;
+    ryml::csubstr str = val.val();
+    return parse(std::string_view(str.str, str.len)).has_value();
   }
   static bool isType(const v8::Local<v8::Value> &val) {
     return val->IsBoolean();
   }
   static bool asType(ryml::ConstNodeRef val) {
-    bool bval;
-    val >> bval;
-    return bval;
+    ryml::csubstr str = val.val();
+    return parse(std::string_view(str.str, str.len)).value_or(bool{});
   }
   static bool asType(const v8::Local<v8::Value> &val, v8::Isolate *isl) {
     return val->BooleanValue(isl);
@@ -39,20 +41,22 @@ struct converter<bool> {
 
 template <>
 struct converter<int32_t> {
+  static std::optional<int32_t> parse(std::string_view str) {
+    return utils::parse<int32_t>(str);
+  }
   static bool isType(ryml::ConstNodeRef val) {
     if(!val.is_keyval() && !val.is_val()) {
       return false;
     }
-    //@todo
-    return true;
+    ryml::csubstr str = val.val();
+    return parse(std::string_view(str.str, str.len)).has_value();
   }
   static bool isType(const v8::Local<v8::Value> &val) {
     return val->IsInt32();
   }
   static int32_t asType(ryml::ConstNodeRef val) {
-    int32_t ival;
-    val >> ival;
-    return ival;
+    ryml::csubstr str = val.val();
+    return parse(std::string_view(str.str, str.len)).value_or(int32_t{});
   }
   static int32_t asType(const v8::Local<v8::Value> &val, v8::Isolate *isl) {
     return val->Int32Value(isl->GetCurrentContext()).FromMaybe(0);
@@ -64,20 +68,22 @@ struct converter<int32_t> {
 
 template <>
 struct converter<uint32_t> {
+  static std::optional<uint32_t> parse(std::string_view str) {
+    return utils::parse<uint32_t>(str);
+  }
   static bool isType(ryml::ConstNodeRef val) {
     if(!val.is_keyval() && !val.is_val()) {
       return false;
     }
-    //@todo
-    return true;
+    ryml::csubstr str = val.val();
+    return parse(std::string_view(str.str, str.len)).has_value();
   }
   static bool isType(const v8::Local<v8::Value> &val) {
     return val->IsUint32();
   }
   static uint32_t asType(ryml::ConstNodeRef val) {
-    uint32_t uival;
-    val >> uival;
-    return uival;
+    ryml::csubstr str = val.val();
+    return parse(std::string_view(str.str, str.len)).value_or(uint32_t{});
   }
   static uint32_t asType(const v8::Local<v8::Value> &val, v8::Isolate *isl) {
     return val->Uint32Value(isl->GetCurrentContext()).FromMaybe(0);
@@ -89,20 +95,22 @@ struct converter<uint32_t> {
 
 template <>
 struct converter<double> {
+  static std::optional<double> parse(std::string_view str) {
+    return utils::parse<double>(str);
+  }
   static bool isType(ryml::ConstNodeRef val) {
     if(!val.is_keyval() && !val.is_val()) {
       return false;
     }
-    //@todo
-    return true;
+    ryml::csubstr str = val.val();
+    return parse(std::string_view(str.str, str.len)).has_value();
   }
   static bool isType(const v8::Local<v8::Value> &val) {
     return val->IsNumber();
   }
   static double asType(ryml::ConstNodeRef val) {
-    double dval;
-    val >> dval;
-    return dval;
+    ryml::csubstr str = val.val();
+    return parse(std::string_view(str.str, str.len)).value_or(double{});
   }
   static double asType(const v8::Local<v8::Value> &val, v8::Isolate *isl) {
     return val->NumberValue(isl->GetCurrentContext()).FromMaybe(0.0);
@@ -114,6 +122,9 @@ struct converter<double> {
 
 template <>
 struct converter<std::string> {
+  static std::optional<std::string> parse(std::string_view str) {
+    return std::string(str);
+  }
   static bool isType(ryml::ConstNodeRef val) {
     if(!val.is_keyval() && !val.is_val()) {
       return false;
@@ -223,16 +234,15 @@ struct js_env {
                            const std::optional<T> default_value = std::nullopt,
                            bool log_errors = true,
                            bool *is_error = nullptr,
-                           const char *check_regex = nullptr,
+                           bool check_placeholders = false,
                            bool *further_eval = nullptr) {
     if(!from.has_child(ryml::to_csubstr(key))) {
       return default_value;
     }
     ryml::NodeRef val = from[ryml::to_csubstr(key)];
 
-    if(check_regex && (val.is_keyval() || val.is_val())) {
-      auto str_val = utils::converter<std::string>::asType(val);
-      if(std::regex_search(utils::converter<std::string>::asType(val), std::regex(check_regex))) {
+    if(check_placeholders && (val.is_keyval() || val.is_val())) {
+      if(utils::has_placeholder(val.val())) {
         *further_eval = true;
         return std::nullopt;
       }
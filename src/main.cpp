@@ -22,13 +22,17 @@ int main(int argc, char *argv[])
                  & clipp::value("path", env.cfg_.in_path),
 
                  clipp::option("-o", "--output-format")
-                 .doc("specify output format [yaml, json]")
+                 .doc("specify output format [yaml, json, ndjson, cbor, msgpack]")
                  & clipp::value("output format", env.cfg_.out_format),
 
                  clipp::option("-oc", "--output-channel")
-                 .doc("specify output channel [stdout, stderr, filename]")
+                 .doc("specify output channel [stdout, stderr, filename], a .gz or .zst filename is compressed")
                  & clipp::value("output channel", env.cfg_.out_channel),
 
+                 clipp::option("--compression-level")
+                 .doc("specify the compression level of a .gz or .zst output channel")
+                 & clipp::value("compression level", env.cfg_.out_compression_level),
+
                  clipp::option("-l", "--log")
                  .doc("specify event log output channel [stderr, stdout, filename]")
                  & clipp::value("event log output", env.cfg_.evt_log_channel),
@@ -37,6 +41,22 @@ int main(int argc, char *argv[])
                  .doc("specify event log verbosity [t, d, i, w, e, c, o]")
                  & clipp::value("event log verbosity", env.cfg_.evt_log_level),
 
+                 clipp::option("--decode")
+                 .doc("decode the input file from a binary output format into yaml [cbor, msgpack]")
+                 & clipp::value("binary format", env.cfg_.decode),
+
+                 clipp::option("-s", "--stream")
+                 .set(env.cfg_.stream_out_, true)
+                 .doc("stream each finished request and conversation to the output channel as it completes"),
+
+                 clipp::option("-w", "--workers")
+                 .doc("specify the number of worker threads conversations are sharded across, 0 means one per core")
+                 & clipp::value("workers", env.cfg_.workers),
+
+                 clipp::option("-k", "--keep-alive")
+                 .set(env.cfg_.keep_alive, true)
+                 .doc("keep a connection per host open across requests, implied by more than one worker"),
+
                  clipp::option("-d", "--daemon")
                  .set(env.cfg_.daemon, true)
                  .doc("start daemon"),
@@ -0,0 +1,301 @@
+#include "plan.h"
+
+//the response of a request-out: code, rtt, a few headers and a body
+#define RESPONSE_OUT_NODES      24
+#define RESPONSE_OUT_ARENA      512
+
+//the iterations summary of an aggregated 'for' and its samples
+#define AGGREGATE_OUT_NODES     24
+#define AGGREGATE_OUT_SAMPLES   3
+
+namespace cbox {
+
+// --------------------
+// --- REQUEST PLAN ---
+// --------------------
+
+static void classify(ryml::ConstNodeRef request_in,
+                     const char *key,
+                     request_plan::field &fld)
+{
+  ryml::csubstr ckey = ryml::to_csubstr(key);
+  if(!request_in.has_child(ckey)) {
+    fld.kind = request_plan::absent;
+    return;
+  }
+  ryml::ConstNodeRef val = request_in[ckey];
+  if(val.is_keyval() || val.is_val()) {
+    fld.value.assign(val.val().str, val.val().len);
+    fld.kind = utils::has_placeholder(val.val()) ? request_plan::templated : request_plan::literal;
+  } else {
+    fld.kind = request_plan::scripted;
+  }
+}
+
+//the values read from a literal 'for' and 'method'
+static void resolve_literals(request_plan &plan)
+{
+  plan.for_count_ = 1;
+  if(plan.for_.kind == request_plan::literal) {
+    plan.for_count_ = utils::converter<uint32_t>::parse(plan.for_.value);
+  }
+
+  plan.http_method_ = utils::http_unknown;
+  if(plan.method_.kind == request_plan::literal) {
+    plan.http_method_ = utils::method_from(plan.method_.value);
+  }
+}
+
+void request_plan::compile(ryml::ConstNodeRef request_in,
+                           std::vector<char> &buf)
+{
+  classify(request_in, key_for, for_);
+  classify(request_in, key_id, id_);
+  classify(request_in, key_method, method_);
+  classify(request_in, key_uri, uri_);
+  classify(request_in, key_query_string, query_string_);
+  classify(request_in, key_data, data_);
+  classify(request_in, key_auth, auth_);
+
+  resolve_literals(*this);
+
+  in_nodes_ = in_arena_ = 0;
+  utils::subtree_size(*request_in.tree(), request_in.id(), in_nodes_, in_arena_);
+
+  aggregate_ = false;
+  if(request_in.has_child(key_out)) {
+    ryml::ConstNodeRef out = request_in[key_out];
+    aggregate_ = out.is_map() &&
+                 out.has_child(key_iterations) &&
+                 out[key_iterations].has_val() &&
+                 out[key_iterations].val() == STR_AGGREGATE;
+  }
+
+  //structured data is sent as its yaml text, unless it is a function
+  if(data_.kind == scripted) {
+    ryml::ConstNodeRef node_data_in = request_in[key_data];
+
+    ryml::Tree tree_data;
+    ryml::NodeRef td_root = tree_data.rootref();
+    td_root |= ryml::MAP;
+    utils::set_tree_node(*node_data_in.tree(),
+                         node_data_in,
+                         td_root,
+                         buf);
+
+    ryml::NodeRef node_data = td_root[key_data];
+    node_data.clear_key();
+
+    std::ostringstream os;
+    os << node_data;
+    data_.value = os.str();
+
+    if(!node_data_in.is_map() || !node_data_in.has_child("function")) {
+      data_.kind = literal;
+    }
+  }
+}
+
+void request_plan::as_recorded()
+{
+  for(field *fld : {&for_, &id_, &method_, &uri_, &query_string_, &data_, &auth_}) {
+    if(fld->kind == templated) {
+      fld->kind = literal;
+    }
+  }
+  resolve_literals(*this);
+}
+
+// ---------------------
+// --- SCENARIO PLAN ---
+// ---------------------
+
+static void scan_references(ryml::ConstNodeRef node,
+                            scenario_plan &plan)
+{
+  if(node.is_map() && (node.has_child(key_before) || node.has_child(key_after))) {
+    plan.handlers_ = true;
+  }
+  if(node.is_map() && node.has_child("function")) {
+    plan.positional_refs_ = true;
+  }
+  if(node.has_val()) {
+    ryml::csubstr val = node.val();
+    size_t from = 0, open, close;
+    while(utils::find_placeholder(val, from, open, close)) {
+      ryml::csubstr content = val.sub(open + 2, close - open - 4).trim(' ');
+      if(content.begins_with('.') ||
+          (content.begins_with('=') && content.find("ref(") != ryml::npos)) {
+        plan.positional_refs_ = true;
+      }
+      for(size_t it = open + 2; it < close - 2;) {
+        size_t end = it;
+        while(end < close - 2 && (std::isalnum((unsigned char)val[end]) || val[end] == '_')) {
+          ++end;
+        }
+        if(end > it) {
+          plan.template_idents_.emplace(val.str + it, end - it);
+          it = end;
+        } else {
+          ++it;
+        }
+      }
+      from = close;
+    }
+  }
+  for(ryml::ConstNodeRef const &child : node.children()) {
+    scan_references(child, plan);
+  }
+}
+
+//whether a subtree runs JavaScript, which can rewrite any output node
+static bool has_script(ryml::ConstNodeRef node)
+{
+  if(node.is_map() &&
+      (node.has_child(key_before) || node.has_child(key_after) || node.has_child("function"))) {
+    return true;
+  }
+  for(ryml::ConstNodeRef const &child : node.children()) {
+    if(has_script(child)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool has_template(ryml::ConstNodeRef node)
+{
+  size_t open, close;
+  if(node.has_val() && utils::find_placeholder(node.val(), 0, open, close)) {
+    return true;
+  }
+  for(ryml::ConstNodeRef const &child : node.children()) {
+    if(has_template(child)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void add_static_out(ryml::ConstNodeRef node,
+                           scenario_plan &plan)
+{
+  if(!node.is_map() || !node.has_child(key_out)) {
+    return;
+  }
+  ryml::ConstNodeRef out = node[key_out];
+  if(!has_script(out) && !has_template(out)) {
+    plan.static_outs_.insert(node.id());
+  }
+}
+
+void scenario_plan::compile(ryml::ConstNodeRef scenario_in,
+                            std::vector<char> &buf)
+{
+  tree_ = scenario_in.tree();
+  requests_.clear();
+  handlers_ = false;
+  positional_refs_ = false;
+  template_idents_.clear();
+  static_outs_.clear();
+  scan_references(scenario_in, *this);
+
+  in_nodes_ = in_arena_ = 0;
+  utils::subtree_size(*tree_, scenario_in.id(), in_nodes_, in_arena_);
+
+  //the scenario-out is seeded with the input right before its scope opens
+  add_static_out(scenario_in, *this);
+
+  if(!scenario_in.is_map() || !scenario_in.has_child(key_conversations)) {
+    return;
+  }
+  ryml::ConstNodeRef conversations_in = scenario_in[key_conversations];
+  if(!conversations_in.is_seq()) {
+    return;
+  }
+
+  //a conversation-out is seeded with the scenario, any script that ran since can rewrite it;
+  //a request-out is copied from the input right before its scope opens;
+  //a response-out is copied with its request, the request's own scripts can rewrite it
+  bool scripted = has_script(scenario_in);
+  for(ryml::ConstNodeRef const &conversation_in : conversations_in.children()) {
+    if(!scripted) {
+      add_static_out(conversation_in, *this);
+    }
+    if(!conversation_in.is_map() || !conversation_in.has_child(key_requests)) {
+      continue;
+    }
+    ryml::ConstNodeRef requests_in = conversation_in[key_requests];
+    if(!requests_in.is_seq()) {
+      continue;
+    }
+    for(ryml::ConstNodeRef const &request_in : requests_in.children()) {
+      if(request_in.is_map()) {
+        requests_[request_in.id()].compile(request_in, buf);
+        add_static_out(request_in, *this);
+        if(request_in.has_child(key_response) && !has_script(request_in)) {
+          add_static_out(request_in[key_response], *this);
+        }
+      }
+    }
+  }
+}
+
+bool scenario_plan::out_capacity(bool prunable,
+                                 size_t &nodes,
+                                 size_t &arena) const
+{
+  bool exact = true;
+  nodes = in_nodes_;
+  arena = in_arena_;
+  for(const auto &it : requests_) {
+    const request_plan &plan = it.second;
+
+    //a pruned request is emitted from the scratch record, only one with an id is kept
+    if(prunable && plan.id_.kind == request_plan::absent) {
+      continue;
+    }
+
+    //a 'for' that is not a literal number is counted once
+    size_t iterations = plan.for_count_.value_or(1);
+    size_t extra_nodes = 0;
+    if(plan.aggregate_) {
+      iterations = std::min<size_t>(iterations, AGGREGATE_OUT_SAMPLES);
+      extra_nodes = AGGREGATE_OUT_NODES;
+    } else if(iterations > reserved_iterations) {
+      iterations = reserved_iterations;
+      exact = false;
+    }
+    nodes += iterations * (plan.in_nodes_ + RESPONSE_OUT_NODES) + extra_nodes;
+    arena += iterations * (plan.in_arena_ + RESPONSE_OUT_ARENA);
+  }
+  if(nodes > reserved_nodes || arena > reserved_arena) {
+    nodes = std::min(nodes, reserved_nodes);
+    arena = std::min(arena, reserved_arena);
+    exact = false;
+  }
+  return exact;
+}
+
+bool scenario_plan::referenced(const char *key) const
+{
+  return handlers_ || positional_refs_ || template_idents_.count(key);
+}
+
+bool scenario_plan::static_out(ryml::ConstNodeRef node_in) const
+{
+  return node_in.valid() &&
+         node_in.tree() == tree_ &&
+         static_outs_.count(node_in.id());
+}
+
+const request_plan *scenario_plan::find(ryml::ConstNodeRef request_in) const
+{
+  if(request_in.tree() != tree_) {
+    return nullptr;
+  }
+  auto it = requests_.find(request_in.id());
+  return it == requests_.end() ? nullptr : &it->second;
+}
+
+}
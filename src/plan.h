@@ -0,0 +1,105 @@
+#pragma once
+#include <unordered_set>
+#include "cbox.h"
+
+namespace cbox {
+
+// --------------------
+// --- REQUEST PLAN ---
+// --------------------
+
+struct request_plan {
+
+  enum field_kind {
+    absent,
+    literal,
+    templated,
+    scripted
+  };
+
+  struct field {
+    field_kind kind = absent;
+
+    //the literal value; for a structured node, its yaml text
+    std::string value;
+  };
+
+  void compile(ryml::ConstNodeRef request_in,
+               std::vector<char> &buf);
+
+  //a replayed request is sent as it was recorded: its fields are literals,
+  //even when their text contains {{ }}
+  void as_recorded();
+
+  field for_, id_, method_, uri_, query_string_, data_, auth_;
+
+  //for a literal 'for', nullopt when it is not a number
+  std::optional<uint32_t> for_count_ = 1;
+
+  //for a literal 'method'
+  utils::http_method http_method_ = utils::http_unknown;
+
+  //out: {iterations: aggregate}, a 'for' renders one node summarizing its iterations
+  bool aggregate_ = false;
+
+  //the size of the request-in, which each iteration's request-out is a copy of
+  size_t in_nodes_ = 0, in_arena_ = 0;
+};
+
+// ---------------------
+// --- SCENARIO PLAN ---
+// ---------------------
+
+struct scenario_plan {
+
+  void compile(ryml::ConstNodeRef scenario_in,
+               std::vector<char> &buf);
+
+  const request_plan *find(ryml::ConstNodeRef request_in) const;
+
+  //estimates the size of the scenario-out: the scenario-in it is seeded with,
+  //plus a request-out and its response for each iteration that is kept;
+  //a long 'for' is counted up to reserved_iterations, the total up to the reserved budget:
+  //past that the tree grows geometrically, as it would without a reservation.
+  //returns false when the estimate was capped
+  bool out_capacity(bool prunable,
+                    size_t &nodes,
+                    size_t &arena) const;
+
+  static constexpr size_t reserved_iterations = 1024;
+  static constexpr size_t reserved_nodes = 1 << 20;
+  static constexpr size_t reserved_arena = 64 << 20;
+
+  //whether an output key can be read back after it is written,
+  //by a {{}} template naming it, by a lifecycle handler
+  //or by anything that reads the output other than through ids
+  bool referenced(const char *key) const;
+
+  //whether the out options of an input node can be resolved once for every scope it opens
+  bool static_out(ryml::ConstNodeRef node_in) const;
+
+  //the tree the plans are compiled from
+  const ryml::Tree *tree_ = nullptr;
+
+  //request plans by node id
+  std::unordered_map<size_t, request_plan> requests_;
+
+  //the scenario defines before/after handlers, which see the whole output
+  bool handlers_ = false;
+
+  //the output is read back other than through ids: by root or positional paths,
+  //by ref() in expressions or by functions, which see the whole output
+  bool positional_refs_ = false;
+
+  //identifiers appearing in {{}} templates
+  std::unordered_set<std::string> template_idents_;
+
+  //input nodes whose out is read as written: it is neither templated
+  //nor reachable by a script before its scope opens, by node id
+  std::unordered_set<size_t> static_outs_;
+
+  //the size of the scenario-in
+  size_t in_nodes_ = 0, in_arena_ = 0;
+};
+
+}
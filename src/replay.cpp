@@ -0,0 +1,222 @@
+#include "replay.h"
+
+#define ERR_FAIL_RESET_REPLAY     "failed to reset replay"
+#define ERR_FAIL_READ_FILE        "failed to read 'file'"
+#define ERR_BAD_SPEED             "bad 'speed'"
+#define ERR_FAIL_LOAD_LOG         "failed to load request log"
+#define ERR_MALFORMED_LOG_ENTRY   "malformed request log entry"
+#define ERR_FAIL_LOAD_BODY_FILE   "failed to load 'bodyFile'"
+
+namespace cbox {
+
+replay::replay(conversation &parent) : parent_(parent),
+  js_env_(parent_.js_env_),
+  event_log_(parent_.event_log_) {}
+
+int replay::reset(ryml::NodeRef replay_in)
+{
+  speed_ = 1.0;
+  entry_ts_.reset();
+  return 0;
+}
+
+int replay::process(const std::string &raw_host,
+                    ryml::NodeRef replay_in,
+                    ryml::NodeRef requests_out)
+{
+  int res = 0;
+
+  if((res = reset(replay_in))) {
+    event_log_->error(ERR_FAIL_RESET_REPLAY);
+    return res;
+  }
+
+  // file
+  auto file = js_env_.eval_as<std::string>(replay_in, key_file);
+  if(!file) {
+    event_log_->error(ERR_FAIL_READ_FILE);
+    return 1;
+  }
+
+  // speed
+  auto speed = js_env_.eval_as<std::string>(replay_in, key_speed, "1x");
+  if(!speed || !parse_speed(*speed)) {
+    event_log_->error("{}:{}", ERR_BAD_SPEED, speed ? *speed : "");
+    return 1;
+  }
+
+  // auth applied to every entry
+  auto auth = js_env_.eval_as<std::string>(replay_in, key_auth);
+
+  if((res = load_log(*file))) {
+    return res;
+  }
+
+  std::optional<double> log_t0;
+  std::chrono::steady_clock::time_point wall_t0;
+
+  ryml::csubstr log = ryml::csubstr(log_buf_.data(), log_buf_.size());
+  while(!log.empty()) {
+    size_t eol = log.find('\n');
+    ryml::csubstr line = (eol == ryml::npos ? log : log.first(eol)).trim(" \t\r");
+    log = (eol == ryml::npos ? ryml::csubstr() : log.sub(eol + 1));
+    if(line.empty()) {
+      continue;
+    }
+
+    if((res = load_entry(line, auth))) {
+      break;
+    }
+
+    // pace the entry at its original inter-arrival time, scaled by speed
+    if(speed_ > 0 && entry_ts_) {
+      if(!log_t0) {
+        log_t0 = entry_ts_;
+        wall_t0 = std::chrono::steady_clock::now();
+      } else {
+        std::chrono::duration<double, std::milli> offset((*entry_ts_ - *log_t0) / speed_);
+        std::this_thread::sleep_until(wall_t0 + std::chrono::duration_cast<std::chrono::steady_clock::duration>(offset));
+      }
+    }
+
+    //recorded fields are sent verbatim, a {{ in a body is not a template
+    entry_plan_.compile(entry_in_.rootref(), ryml_replay_buf_);
+    entry_plan_.as_recorded();
+
+    request req(parent_);
+    if((res = req.process(raw_host,
+                          entry_in_.rootref(),
+                          requests_out,
+                          &entry_plan_))) {
+      break;
+    }
+  }
+
+  return res;
+}
+
+int replay::load_log(const std::string &file_name)
+{
+  std::ostringstream fpath;
+  fpath << parent_.parent_.ctx_.cfg_.in_path << "/" << file_name;
+
+  int error = 0;
+  if(!utils::file_get_contents(fpath.str().c_str(), log_buf_, event_log_.get(), error)) {
+    event_log_->error("{}:{}", ERR_FAIL_LOAD_LOG, fpath.str());
+    return 1;
+  }
+  return 0;
+}
+
+int replay::load_entry(ryml::csubstr line,
+                       const std::optional<std::string> &auth)
+{
+  context &ctx = parent_.parent_.ctx_;
+  bool malformed = false;
+
+  ryml::Tree entry;
+  ctx.REH_.install();
+  ctx.REH_.check_error_occurs([&] {
+    entry = ryml::parse_in_arena(line);
+  }, [&](std::runtime_error const &e) {
+    event_log_->error("{}\n{}", ERR_MALFORMED_LOG_ENTRY, e.what());
+    malformed = true;
+  });
+  ctx.REH_.uninstall();
+
+  if(malformed) {
+    return 1;
+  }
+
+  ryml::NodeRef entry_root = entry.rootref();
+  if(!entry_root.is_map() || !entry_root.has_child(key_method) || !entry_root.has_child(key_uri)) {
+    event_log_->error("{}:{}", ERR_MALFORMED_LOG_ENTRY, std::string(line.str, line.len));
+    return 1;
+  }
+
+  // rebuild the request-in from the log entry
+  entry_in_.clear();
+  ryml::NodeRef req_root = entry_in_.rootref();
+  req_root |= ryml::MAP;
+  utils::set_tree_node(entry,
+                       entry_root,
+                       req_root,
+                       ryml_replay_buf_);
+
+  // ts
+  entry_ts_.reset();
+  if(req_root.has_child(key_ts)) {
+    entry_ts_ = utils::converter<double>::parse(utils::converter<std::string>::asType(req_root[key_ts]));
+    if(!entry_ts_) {
+      event_log_->error("{}:{}", ERR_MALFORMED_LOG_ENTRY, std::string(line.str, line.len));
+      return 1;
+    }
+    req_root.remove_child(key_ts);
+  }
+
+  // uri, a logged uri is absolute and may carry the query string
+  std::string uri = utils::converter<std::string>::asType(req_root[key_uri]);
+  utils::ltrim(uri, "/");
+  size_t qs_pos = uri.find('?');
+  if(qs_pos != std::string::npos) {
+    if(!req_root.has_child(key_query_string)) {
+      req_root[key_query_string] << uri.substr(qs_pos + 1);
+    }
+    uri.erase(qs_pos);
+  }
+  req_root.remove_child(key_uri);
+  req_root[key_uri] << uri;
+
+  // body reference
+  if(req_root.has_child(key_body)) {
+    std::string body = utils::converter<std::string>::asType(req_root[key_body]);
+    req_root.remove_child(key_body);
+    req_root[key_data] << body;
+  } else if(req_root.has_child(key_body_file)) {
+    std::string body_file = utils::converter<std::string>::asType(req_root[key_body_file]);
+    req_root.remove_child(key_body_file);
+
+    std::ostringstream fpath;
+    fpath << ctx.cfg_.in_path << "/" << body_file;
+    std::vector<char> body;
+    int error = 0;
+    if(!utils::file_get_contents(fpath.str().c_str(), body, event_log_.get(), error) && error) {
+      event_log_->error("{}:{}", ERR_FAIL_LOAD_BODY_FILE, fpath.str());
+      return 1;
+    }
+    req_root[key_data] << ryml::csubstr(body.data(), body.size());
+  }
+
+  // auth, only from the replay: a recorded one is dropped
+  if(req_root.has_child(key_auth)) {
+    req_root.remove_child(key_auth);
+  }
+  if(auth) {
+    req_root[key_auth] << *auth;
+  }
+
+  return 0;
+}
+
+bool replay::parse_speed(const std::string &speed)
+{
+  if(speed == STR_MAX) {
+    speed_ = 0;
+    return true;
+  }
+  char *end = nullptr;
+  double factor = std::strtod(speed.c_str(), &end);
+  if(end == speed.c_str() || factor <= 0) {
+    return false;
+  }
+  if(*end == 'x') {
+    ++end;
+  }
+  if(*end) {
+    return false;
+  }
+  speed_ = factor;
+  return true;
+}
+
+}
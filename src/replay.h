@@ -0,0 +1,57 @@
+#pragma once
+#include "request.h"
+
+namespace cbox {
+
+struct replay {
+
+    replay(conversation &parent);
+
+    int reset(ryml::NodeRef replay_in);
+
+    int process(const std::string &raw_host,
+                ryml::NodeRef replay_in,
+                ryml::NodeRef requests_out);
+
+  private:
+
+    int load_log(const std::string &file_name);
+
+    int load_entry(ryml::csubstr line,
+                   const std::optional<std::string> &auth);
+
+    bool parse_speed(const std::string &speed);
+
+    // -----------
+    // --- REP ---
+    // -----------
+
+    //parent
+    conversation &parent_;
+
+    //js environment
+    js::js_env &js_env_;
+
+    //event logger
+    std::shared_ptr<spdlog::logger> event_log_;
+
+    //request log load buffer
+    std::vector<char> log_buf_;
+
+    //ryml replay support buffer
+    std::vector<char> ryml_replay_buf_;
+
+    //the request-in rebuilt from the current log entry
+    ryml::Tree entry_in_;
+
+    //the plan of the current log entry, with its fields taken as literals
+    request_plan entry_plan_;
+
+    //timestamp of the current log entry in milliseconds, if any
+    std::optional<double> entry_ts_;
+
+    //replay speed factor, 0 means as fast as possible
+    double speed_ = 1.0;
+};
+
+}
@@ -2,11 +2,12 @@
 #include "conversation.h"
 #include "request.h"
 
-#define ERR_FAIL_RESET_REQ    "failed to reset request"
-#define ERR_FAIL_READ_FOR     "failed to read 'for'"
-#define ERR_FAIL_READ_METHOD  "failed to read 'method'"
-#define ERR_BAD_METHOD        "bad 'method'"
-#define ERR_FAIL_READ_URI     "failed to read 'uri'"
+#define ERR_FAIL_RESET_REQ      "failed to reset request"
+#define ERR_FAIL_READ_FOR       "failed to read 'for'"
+#define ERR_FAIL_READ_METHOD    "failed to read 'method'"
+#define ERR_BAD_METHOD          "bad 'method'"
+#define ERR_FAIL_READ_URI       "failed to read 'uri'"
+#define ERR_FAIL_READ_THROTTLE  "failed to read 'throttle'"
 
 const std::string algorithm = "AWS4-HMAC-SHA256";
 
@@ -15,6 +16,7 @@ namespace cbox {
 request::request(conversation &parent) : parent_(parent),
   scen_out_p_resolv_(parent_.scen_out_p_resolv_),
   scen_p_evaluator_(parent_.scen_p_evaluator_),
+  interner_(parent_.interner_),
   indexed_nodes_map_(parent_.indexed_nodes_map_),
   js_env_(parent_.js_env_),
   event_log_(parent_.event_log_) {}
@@ -22,17 +24,16 @@ request::request(conversation &parent) : parent_(parent),
 int request::reset(const std::string &raw_host,
                    ryml::NodeRef request_in)
 {
-  // connection reset
-  conv_conn_.reset(new RestClient::Connection(raw_host));
-  conv_conn_->SetVerifyPeer(false);
-  conv_conn_->SetVerifyHost(false);
-  conv_conn_->SetTimeout(30);
+  // connection from the scenario's pool
+  raw_host_ = raw_host;
+  conv_conn_ = &parent_.parent_.get_connection(raw_host);
   return 0;
 }
 
 int request::process(const std::string &raw_host,
                      ryml::NodeRef request_in,
-                     ryml::NodeRef requests_out)
+                     ryml::NodeRef requests_out,
+                     const request_plan *plan)
 {
   int res = 0;
 
@@ -41,31 +42,73 @@ int request::process(const std::string &raw_host,
     return res;
   }
 
+  // the plan compiled for this request, a request-in outside the scenario is compiled here
+  if(!plan) {
+    plan = parent_.parent_.plan_.find(request_in);
+  }
+  if(!plan) {
+    local_plan_.compile(request_in, ryml_request_out_buf_);
+    plan = &local_plan_;
+  }
+
   // for
-  bool further_eval = false;
-  auto pfor = js_env_.eval_as<uint32_t>(request_in,
-                                        key_for,
-                                        1,
-                                        true,
-                                        nullptr,
-                                        PROP_EVAL_RGX,
-                                        &further_eval);
+  scen_p_evaluator_.iteration_ = 0;
+  std::optional<uint32_t> pfor = plan->for_count_;
+  if(plan->for_.kind == request_plan::templated) {
+    pfor = scen_p_evaluator_.eval_as<uint32_t>(request_in,
+                                               key_for,
+                                               scen_out_p_resolv_);
+  } else if(plan->for_.kind == request_plan::scripted) {
+    pfor = js_env_.eval_as<uint32_t>(request_in, key_for);
+  }
   if(!pfor) {
-    if(further_eval) {
-      pfor = scen_p_evaluator_.eval_as<uint32_t>(request_in,
-                                                 key_for,
-                                                 scen_out_p_resolv_);
-    }
-    if(!pfor) {
-      event_log_->error(ERR_FAIL_READ_FOR);
+    event_log_->error(ERR_FAIL_READ_FOR);
+    return 1;
+  }
+
+  // throttle, the request's own overrides the conversation's
+  throttle_ = parent_.throttle_;
+  if(request_in.has_child(key_throttle)) {
+    if(parent_.read_throttle(request_in[key_throttle], throttle_)) {
+      event_log_->error(ERR_FAIL_READ_THROTTLE);
       return 1;
     }
   }
 
+  //a request nothing can read back is kept only until it is emitted
+  bool scratch = parent_.parent_.prunable_ &&
+                 plan->id_.kind == request_plan::absent &&
+                 !parent_.has_id_;
+
+  //aggregated iterations render into a tree of their own, reused by each one
+  aggregating_ = plan->aggregate_;
+  ryml::NodeRef aggregate_out;
+  std::optional<scenario::stream_scope> aggregate_streamed;
+  if(aggregating_) {
+    aggregate_.reset();
+    samples_.clear();
+    samples_.clear_arena();
+    samples_.rootref() |= ryml::MAP;
+    aggregate_out = parent_.parent_.request_out_node(requests_out, scratch);
+    aggregate_out |= ryml::MAP;
+    aggregate_streamed.emplace(parent_.parent_, aggregate_out);
+  }
+
   for(uint32_t i = 0; i < pfor; ++i) {
-    bool error = false;
+    scen_p_evaluator_.iteration_ = i;
+    bool error = false, stop = false;
+    aggregate_.iteration_failed_ = false;
     {
-      ryml::NodeRef request_out = requests_out.append_child();
+      ryml::NodeRef request_out;
+      std::optional<scenario::stream_scope> streamed;
+      if(aggregating_) {
+        iteration_out_.clear();
+        iteration_out_.clear_arena();
+        request_out = iteration_out_.rootref();
+      } else {
+        request_out = parent_.parent_.request_out_node(requests_out, scratch);
+        streamed.emplace(parent_.parent_, request_out);
+      }
       request_out |= ryml::MAP;
       utils::set_tree_node(*request_in.tree(),
                            request_in,
@@ -82,179 +125,97 @@ int request::process(const std::string &raw_host,
                                   error,
                                   utils::get_default_request_out_options());
       if(error) {
-        return 1;
-      }
-
-      if(scope.enabled_) {
+        stop = true;
+      } else if(scope.enabled_) {
         parent_.stats_.incr_request_count();
         parent_.parent_.stats_.incr_request_count();
 
         //id
-        further_eval = false;
-        auto id = js_env_.eval_as<std::string>(request_in,
-                                               key_id,
-                                               std::nullopt,
-                                               true,
-                                               nullptr,
-                                               PROP_EVAL_RGX,
-                                               &further_eval);
-        if(!id) {
-          if(further_eval) {
-            id = scen_p_evaluator_.eval_as<std::string>(request_in,
-                                                        key_id,
-                                                        scen_out_p_resolv_);
-          }
-        }
-        if(id) {
-          indexed_nodes_map_[*id] = request_out;
+        id_ = eval_field(plan->id_, request_in, key_id);
+        if(id_) {
+          indexed_nodes_map_[interner_.intern(*id_)] = request_out;
         }
 
         // method
-        further_eval = false;
-        auto method = js_env_.eval_as<std::string>(request_in,
-                                                   key_method,
-                                                   std::nullopt,
-                                                   true,
-                                                   nullptr,
-                                                   PROP_EVAL_RGX,
-                                                   &further_eval);
+        auto method = eval_field(plan->method_, request_in, key_method);
+        utils::http_method http_method = plan->http_method_;
         if(!method) {
-          if(further_eval) {
-            method = scen_p_evaluator_.eval_as<std::string>(request_in,
-                                                            key_method,
-                                                            scen_out_p_resolv_);
-          }
-          if(!method) {
-            res = 1;
-            event_log_->error(ERR_FAIL_READ_METHOD);
-            utils::clear_map_node_put_key_val(request_out, key_error, ERR_FAIL_READ_METHOD);
-          }
+          res = 1;
+          event_log_->error(ERR_FAIL_READ_METHOD);
+          utils::clear_map_node_put_key_val(request_out, key_error, ERR_FAIL_READ_METHOD);
+        } else if(plan->method_.kind != request_plan::literal) {
+          http_method = utils::method_from(*method);
+          request_out.remove_child(key_method);
+          request_out[key_method] << *method;
+        }
+        if(!res && http_method == utils::http_unknown) {
+          res = 1;
+          event_log_->error("{}:{}", ERR_BAD_METHOD, *method);
+          utils::clear_map_node_put_key_val(request_out, key_error, ERR_BAD_METHOD);
         }
-        request_out.remove_child(key_method);
-        request_out[key_method] << *method;
 
         // uri
-        further_eval = false;
         std::optional<std::string> uri;
         if(!res) {
-          uri = js_env_.eval_as<std::string>(request_in,
-                                             key_uri,
-                                             std::nullopt,
-                                             true,
-                                             nullptr,
-                                             PROP_EVAL_RGX,
-                                             &further_eval);
+          uri = eval_field(plan->uri_, request_in, key_uri);
           if(!uri) {
-            if(further_eval) {
-              uri = scen_p_evaluator_.eval_as<std::string>(request_in,
-                                                           key_uri,
-                                                           scen_out_p_resolv_);
-            }
-            if(!uri) {
-              res = 1;
-              event_log_->error(ERR_FAIL_READ_URI);
-              utils::clear_map_node_put_key_val(request_out, key_error, ERR_FAIL_READ_URI);
-            }
+            res = 1;
+            event_log_->error(ERR_FAIL_READ_URI);
+            utils::clear_map_node_put_key_val(request_out, key_error, ERR_FAIL_READ_URI);
+          } else if(plan->uri_.kind != request_plan::literal) {
+            request_out.remove_child(key_uri);
+            request_out[key_uri] << *uri;
           }
-          request_out.remove_child(key_uri);
-          request_out[key_uri] << *uri;
         }
 
+        //fields the http request does not need are evaluated only when dumped or read back
+        bool mocked = request_in.has_child(key_mock);
+        auto needed = [&](const char *key, utils::out_options::dump_key dk, bool for_http) {
+          return for_http || scope.dumps(dk) || parent_.parent_.plan_.referenced(key);
+        };
+
         // query_string
-        further_eval = false;
         std::optional<std::string> query_string;
-        if(!res) {
-          query_string = js_env_.eval_as<std::string>(request_in,
-                                                      key_query_string,
-                                                      std::nullopt,
-                                                      true,
-                                                      nullptr,
-                                                      PROP_EVAL_RGX,
-                                                      &further_eval);
-          if(further_eval) {
-            query_string = scen_p_evaluator_.eval_as<std::string>(request_in,
-                                                                  key_query_string,
-                                                                  scen_out_p_resolv_);
-            if(!query_string) {
-              res = 1;
-              event_log_->error(ERR_FAIL_EVAL);
-              utils::clear_map_node_put_key_val(request_out, key_error, ERR_FAIL_EVAL);
-            }
-          }
-          if(query_string) {
+        if(!res && needed(key_query_string, utils::out_options::dump_query_string, !mocked)) {
+          query_string = eval_field(plan->query_string_, request_in, key_query_string);
+          if(!query_string && plan->query_string_.kind == request_plan::templated) {
+            res = 1;
+            event_log_->error(ERR_FAIL_EVAL);
+            utils::clear_map_node_put_key_val(request_out, key_error, ERR_FAIL_EVAL);
+          } else if(query_string && plan->query_string_.kind != request_plan::literal) {
             request_out.remove_child(key_query_string);
             request_out[key_query_string] << *query_string;
           }
         }
 
         // data
-        further_eval = false;
         std::optional<std::string> data;
-        bool is_error = false;
-        if(!res) {
-          data = js_env_.eval_as<std::string>(request_in,
-                                              key_data,
-                                              std::nullopt,
-                                              false,
-                                              &is_error,
-                                              PROP_EVAL_RGX,
-                                              &further_eval);
-          if(is_error && request_in.has_child(key_data)) {
-            ryml::NodeRef node_data_in = request_in[key_data];
-
-            ryml::Tree tree_data;
-            ryml::NodeRef td_root = tree_data.rootref();
-            td_root |= ryml::MAP;
-            utils::set_tree_node(*node_data_in.tree(),
-                                 node_data_in,
-                                 td_root,
-                                 ryml_request_out_buf_);
-
-            ryml::NodeRef node_data = td_root[key_data];
-            node_data.clear_key();
-
-            std::ostringstream os;
-            os << node_data;
-            data.emplace(os.str());
-          }
-          if(further_eval) {
-            data = scen_p_evaluator_.eval_as<std::string>(request_in,
-                                                          key_data,
-                                                          scen_out_p_resolv_);
-            if(!data) {
-              res = 1;
-              event_log_->error(ERR_FAIL_EVAL);
-              utils::clear_map_node_put_key_val(request_out, key_error, ERR_FAIL_EVAL);
-            }
+        bool has_body = http_method == utils::http_post || http_method == utils::http_put;
+        if(!res && needed(key_data, utils::out_options::dump_data, has_body && !mocked)) {
+          bool is_error = false;
+          data = eval_field(plan->data_, request_in, key_data, &is_error);
+          if(is_error) {
+            data = plan->data_.value;
           }
-          if(data) {
+          if(!data && plan->data_.kind == request_plan::templated) {
+            res = 1;
+            event_log_->error(ERR_FAIL_EVAL);
+            utils::clear_map_node_put_key_val(request_out, key_error, ERR_FAIL_EVAL);
+          } else if(data && (plan->data_.kind != request_plan::literal || !request_out[key_data].has_val())) {
             request_out.remove_child(key_data);
             request_out[key_data] << *data;
           }
         }
 
         // auth
-        further_eval = false;
         std::optional<std::string> auth;
-        if(!res) {
-          auth = js_env_.eval_as<std::string>(request_in,
-                                              key_auth,
-                                              std::nullopt,
-                                              true,
-                                              nullptr,
-                                              PROP_EVAL_RGX,
-                                              &further_eval);
-          if(further_eval) {
-            auth = scen_p_evaluator_.eval_as<std::string>(request_in,
-                                                          key_auth,
-                                                          scen_out_p_resolv_);
-            if(!auth) {
-              res = 1;
-              event_log_->error(ERR_FAIL_EVAL);
-              utils::clear_map_node_put_key_val(request_out, key_error, ERR_FAIL_EVAL);
-            }
-          }
-          if(auth) {
+        if(!res && needed(key_auth, utils::out_options::dump_auth, !mocked)) {
+          auth = eval_field(plan->auth_, request_in, key_auth);
+          if(!auth && plan->auth_.kind == request_plan::templated) {
+            res = 1;
+            event_log_->error(ERR_FAIL_EVAL);
+            utils::clear_map_node_put_key_val(request_out, key_error, ERR_FAIL_EVAL);
+          } else if(auth && plan->auth_.kind != request_plan::literal) {
             request_out.remove_child(key_auth);
             request_out[key_auth] << *auth;
           }
@@ -265,7 +226,7 @@ int request::process(const std::string &raw_host,
           response_mock_ = request_in[key_mock];
         }
 
-        if(!res && (res = execute(*method,
+        if(!res && (res = execute(http_method,
                                   auth,
                                   *uri,
                                   query_string,
@@ -275,21 +236,143 @@ int request::process(const std::string &raw_host,
         if(!res) {
           scope.commit();
         } else {
-          break;
+          stop = true;
         }
       } else {
         utils::clear_map_node_put_key_val(request_out, key_enabled, STR_FALSE);
-        break;
+        stop = true;
       }
     }
+    if(aggregating_) {
+      sample_iteration(i, res || error || aggregate_.iteration_failed_);
+    }
     if(error) {
-      return 1;
+      res = 1;
+      break;
     }
+    if(stop) {
+      break;
+    }
+  }
+
+  if(aggregating_) {
+    render_aggregate(aggregate_out);
+    aggregating_ = false;
   }
 
+  //i is 0 outside of a 'for'
+  scen_p_evaluator_.iteration_ = 0;
   return res;
 }
 
+// -----------------
+// --- AGGREGATE ---
+// -----------------
+
+void request::aggregate::reset()
+{
+  count_ = failed_ = 0;
+  categorization_.clear();
+  rtt_hist_.reset();
+  iteration_failed_ = false;
+}
+
+void request::aggregate::record(utils::interner::handle code_key,
+                                int32_t code,
+                                int64_t rtt)
+{
+  ++count_;
+  ++categorization_[code_key];
+  rtt_hist_.record((uint64_t)std::max<int64_t>(0, rtt));
+  if(code < 100 || code >= 500) {
+    ++failed_;
+    iteration_failed_ = true;
+  }
+}
+
+void request::sample_iteration(uint32_t i,
+                               bool failed)
+{
+  ryml::NodeRef samples_root = samples_.rootref();
+  ryml::csubstr key;
+  if(i == 0) {
+    key = key_first;
+  } else if(failed && !samples_root.has_child(key_failed)) {
+    key = key_failed;
+  } else {
+    return;
+  }
+  ryml::NodeRef sample = samples_root[key];
+  sample |= ryml::MAP;
+  utils::set_tree_node(iteration_out_,
+                       iteration_out_.rootref(),
+                       sample,
+                       ryml_request_out_buf_);
+  //the first iteration may be the first failed one as well
+  if(i == 0 && failed) {
+    ryml::NodeRef failed_sample = samples_root[key_failed];
+    failed_sample |= ryml::MAP;
+    utils::set_tree_node(iteration_out_,
+                         iteration_out_.rootref(),
+                         failed_sample,
+                         ryml_request_out_buf_);
+  }
+}
+
+void request::render_aggregate(ryml::NodeRef aggregate_out)
+{
+  //the fields identifying the request, as the last iteration rendered them
+  ryml::ConstNodeRef iteration_root = iteration_out_.rootref();
+  auto put_field = [&](const char *key) {
+    ryml::ConstNodeRef node = iteration_root.find_child(ryml::to_csubstr(key));
+    if(node.valid() && node.has_val()) {
+      aggregate_out[ryml::to_csubstr(key)] << node.val();
+    }
+  };
+  put_field(key_id);
+  put_field(key_method);
+  put_field(key_uri);
+
+  ryml::NodeRef iterations = aggregate_out[key_iterations];
+  iterations |= ryml::MAP;
+  iterations[key_count] << aggregate_.count_;
+  iterations[key_failed] << aggregate_.failed_;
+
+  ryml::NodeRef categorization = iterations[key_categorization];
+  categorization |= ryml::MAP;
+  for(const auto &it : aggregate_.categorization_) {
+    ryml::csubstr code = categorization.to_arena(interner_.str(it.first));
+    categorization[code] << it.second;
+  }
+
+  //milliseconds, upper bounds of the histogram buckets
+  ryml::NodeRef rtt = iterations[key_rtt];
+  rtt |= ryml::MAP;
+  rtt[key_p50] << fmt::format("{:.3f}", aggregate_.rtt_hist_.quantile(0.50) / 1000000.0);
+  rtt[key_p90] << fmt::format("{:.3f}", aggregate_.rtt_hist_.quantile(0.90) / 1000000.0);
+  rtt[key_p99] << fmt::format("{:.3f}", aggregate_.rtt_hist_.quantile(0.99) / 1000000.0);
+  rtt[key_max] << fmt::format("{:.3f}", aggregate_.rtt_hist_.quantile(1.0) / 1000000.0);
+
+  ryml::NodeRef samples = iterations[key_samples];
+  samples |= ryml::MAP;
+  utils::set_tree_node(samples_,
+                       samples_.rootref(),
+                       samples,
+                       ryml_request_out_buf_);
+  if(iteration_root.is_map() && iteration_root.num_children()) {
+    ryml::NodeRef last = samples[key_last];
+    last |= ryml::MAP;
+    utils::set_tree_node(iteration_out_,
+                         iteration_out_.rootref(),
+                         last,
+                         ryml_request_out_buf_);
+    //an id refers to the last iteration
+    if(id_) {
+      indexed_nodes_map_[interner_.intern(*id_)] = last;
+    }
+  }
+}
+
 int request::process_response(const RestClient::Response &resRC,
                               const int64_t rtt,
                               ryml::NodeRef response_in,
@@ -306,13 +389,21 @@ int request::process_response(const RestClient::Response &resRC,
       return 1;
     }
 
-    ryml::ConstNodeRef out_opts_root = scope.out_opts_.rootref();
-    ryml::ConstNodeRef fopts = out_opts_root[key_format];
+    const utils::out_options &out_opts = *scope.out_opts_;
 
     response_out[key_code] << resRC.code;
-    std::string rttf;
-    fopts[key_rtt] >> rttf;
-    response_out[key_rtt] << utils::from_nano(rtt, utils::from_literal(rttf));
+    response_out[key_rtt] << utils::from_nano(rtt, out_opts.rtt_);
+
+    //as measured by curl, a mocked response has no transfer
+    if((throttle_.upload || throttle_.download) && !response_mock_.valid()) {
+      const utils::transfer_info &transfer = conv_conn_->last_transfer();
+      ryml::NodeRef stats = response_out[key_stats];
+      stats |= ryml::MAP;
+      stats[key_sent] << transfer.sent;
+      stats[key_received] << transfer.received;
+      stats[key_upload] << transfer.upload_rate;
+      stats[key_download] << transfer.download_rate;
+    }
 
     if(!resRC.headers.empty()) {
       ryml::NodeRef headers = response_out[key_headers];
@@ -324,23 +415,34 @@ int request::process_response(const RestClient::Response &resRC,
     }
 
     if(resRC.code != CURLE_GOT_NOTHING && !resRC.body.empty()) {
-      if(fopts[key_body] == STR_JSON) {
-        ryml::set_callbacks(parent_.parent_.ctx_.REH_.callbacks());
+      //a json body is an object or an array, anything else is rendered as a string
+      ryml::csubstr body_lead = ryml::to_csubstr(resRC.body).triml(" \t\r\n");
+      bool body_json = body_lead.begins_with('{') || body_lead.begins_with('[');
+      if(out_opts.body_ == utils::out_options::body_json && body_json) {
+        parent_.parent_.ctx_.REH_.install();
         parent_.parent_.ctx_.REH_.check_error_occurs([&] {
-          std::stringstream ss;
-          ss << resRC.body;
-          ryml::Tree body = ryml::parse_in_arena(ryml::to_csubstr(ss.str()));
+          //the body is copied once, into the arena of the output, and parsed in place there
           ryml::NodeRef response_body = response_out[key_body];
-          response_body |= ryml::MAP;
-          utils::set_tree_node(body,
-                               body.rootref(),
-                               response_body,
-                               ryml_request_out_buf_);
+          response_body |= body_lead.begins_with('[') ? ryml::SEQ : ryml::MAP;
+          ryml::parse_in_arena(ryml::to_csubstr(resRC.body), response_body);
         },
         [&](std::runtime_error const &e) {
+          //a malformed body may have been parsed in part
+          if(response_out.has_child(key_body)) {
+            response_out.remove_child(key_body);
+          }
           response_out[key_body] << resRC.body |= ryml::KEYVAL;
         });
-        ryml::set_callbacks(parent_.parent_.ctx_.REH_.defaults);
+        parent_.parent_.ctx_.REH_.uninstall();
+      } else if(out_opts.body_ == utils::out_options::body_xml) {
+        ryml::NodeRef response_body = response_out[key_body];
+        response_body |= ryml::MAP;
+        std::string xml_error;
+        if(!codec::decode_xml(ryml::to_csubstr(resRC.body), response_body, xml_error)) {
+          event_log_->debug("xml body:{}", xml_error);
+          response_out.remove_child(key_body);
+          response_out[key_body] << resRC.body |= ryml::KEYVAL;
+        }
       } else {
         response_out[key_body] << resRC.body |= ryml::KEYVAL;
       }
@@ -354,7 +456,7 @@ int request::process_response(const RestClient::Response &resRC,
   }
 }
 
-int request::execute(const std::string &method,
+int request::execute(utils::http_method method,
                      const std::optional<std::string> &auth,
                      const std::string &uri,
                      const std::optional<std::string> &query_string,
@@ -373,14 +475,12 @@ int request::execute(const std::string &method,
 
     ryml::NodeRef header_node = request_out[key_headers];
     for(ryml::NodeRef hdr : header_node.children()) {
-      std::ostringstream os;
-      os << hdr.key();
-      auto hdr_val = js_env_.eval_as<std::string>(header_node, os.str().c_str(), "");
+      std::string key(hdr.key().str, hdr.key().len);
+      auto hdr_val = js_env_.eval_as<std::string>(header_node, key.c_str(), "");
       if(!hdr_val) {
         res = 1;
       } else {
-        auto key = os.str();
-        reqHF[key.c_str()] = *hdr_val;
+        reqHF[key] = *hdr_val;
         ryml::csubstr arena_key = rh_root.to_arena(key);
         rh_root[arena_key] << *hdr_val;
       }
@@ -397,35 +497,41 @@ int request::execute(const std::string &method,
   }
 
   // invoke http-method
-  if(method == HTTP_GET) {
-    res = get(reqHF, auth, uri, query_string, [&](const RestClient::Response &res, const int64_t rtt) -> int {
-      return on_response(res, rtt,
-                         request_in,
-                         request_out); });
-  } else if(method == HTTP_POST) {
-    res = post(reqHF, auth, uri, query_string, data, [&](const RestClient::Response &res, const int64_t rtt) -> int {
-      return on_response(res, rtt,
-                         request_in,
-                         request_out); });
-  } else if(method == HTTP_PUT) {
-    res = put(reqHF, auth, uri, query_string, data, [&](const RestClient::Response &res, const int64_t rtt) -> int {
-      return on_response(res, rtt,
-                         request_in,
-                         request_out); });
-  } else if(method == HTTP_DELETE) {
-    res = del(reqHF, auth, uri, query_string, [&](const RestClient::Response &res, const int64_t rtt) -> int {
-      return on_response(res, rtt,
-                         request_in,
-                         request_out); });
-  } else if(method == HTTP_HEAD) {
-    res = head(reqHF, auth, uri, query_string, [&](const RestClient::Response &res, const int64_t rtt) -> int {
-      return on_response(res, rtt,
-                         request_in,
-                         request_out); });
-  } else {
-    event_log_->error("{}:{}", ERR_BAD_METHOD, method);
-    utils::clear_map_node_put_key_val(request_out, key_error, ERR_BAD_METHOD);
-    res = 1;
+  switch(method) {
+    case utils::http_get:
+      res = get(reqHF, auth, uri, query_string, [&](const RestClient::Response &res, const int64_t rtt) -> int {
+        return on_response(res, rtt,
+                           request_in,
+                           request_out); });
+      break;
+    case utils::http_post:
+      res = post(reqHF, auth, uri, query_string, data, [&](const RestClient::Response &res, const int64_t rtt) -> int {
+        return on_response(res, rtt,
+                           request_in,
+                           request_out); });
+      break;
+    case utils::http_put:
+      res = put(reqHF, auth, uri, query_string, data, [&](const RestClient::Response &res, const int64_t rtt) -> int {
+        return on_response(res, rtt,
+                           request_in,
+                           request_out); });
+      break;
+    case utils::http_delete:
+      res = del(reqHF, auth, uri, query_string, [&](const RestClient::Response &res, const int64_t rtt) -> int {
+        return on_response(res, rtt,
+                           request_in,
+                           request_out); });
+      break;
+    case utils::http_head:
+      res = head(reqHF, auth, uri, query_string, [&](const RestClient::Response &res, const int64_t rtt) -> int {
+        return on_response(res, rtt,
+                           request_in,
+                           request_out); });
+      break;
+    default:
+      event_log_->error(ERR_BAD_METHOD);
+      utils::clear_map_node_put_key_val(request_out, key_error, ERR_BAD_METHOD);
+      res = 1;
   }
   return res;
 }
@@ -436,14 +542,31 @@ int request::on_response(const RestClient::Response &resRC,
                          ryml::NodeRef request_out)
 {
   int res = 0;
-  std::ostringstream os;
-  os << resRC.code;
+  char code_buf[16];
+  auto [code_end, ec] = std::to_chars(code_buf, code_buf + sizeof(code_buf), resRC.code);
+  utils::interner::handle code = interner_.intern(std::string_view(code_buf, code_end - code_buf));
 
   // update conv stats
-  parent_.stats_.incr_categorization(os.str());
+  parent_.stats_.incr_categorization(code);
 
   // update scenario stats
-  parent_.parent_.stats_.incr_categorization(os.str());
+  parent_.parent_.stats_.incr_categorization(code);
+  parent_.parent_.stats_.record_response(resRC.code, rtt);
+  if(aggregating_) {
+    aggregate_.record(code, resRC.code, rtt);
+  }
+
+  // update connection stats, mocked responses never touch a socket
+  if(!response_mock_.valid()) {
+    utils::conn_stats event = parent_.parent_.track_connection(raw_host_, resRC, conv_conn_->last_transfer());
+    parent_.stats_.record_connection(raw_host_, event);
+    parent_.parent_.stats_.record_connection(raw_host_, event);
+  }
+
+  //no writer runs in daemon mode, where the scenario-out is the response
+  if(parent_.parent_.ctx_.event_writer_.started()) {
+    write_event(resRC, rtt, request_out);
+  }
 
   ryml::NodeRef response_in;
   if(request_in.has_child(key_response)) {
@@ -459,6 +582,40 @@ int request::on_response(const RestClient::Response &resRC,
   return res;
 }
 
+void request::write_event(const RestClient::Response &resRC,
+                          const int64_t rtt,
+                          ryml::ConstNodeRef request_out)
+{
+  context &ctx = parent_.parent_.ctx_;
+  std::string line;
+  line.reserve(256);
+  fmt::format_to(std::back_inserter(line),
+                 "{{\"scenario\":{},\"conversation\":{},\"request\":{}",
+                 ctx.scenario_idx_,
+                 parent_.idx_,
+                 parent_.event_idx_++);
+  if(id_) {
+    line += ",\"id\":";
+    utils::append_json_string(line, *id_);
+  }
+  auto put_str = [&](const char *key) {
+    ryml::ConstNodeRef node = request_out.find_child(ryml::to_csubstr(key));
+    if(node.valid() && node.has_val()) {
+      fmt::format_to(std::back_inserter(line), ",\"{}\":", key);
+      utils::append_json_string(line, std::string_view(node.val().str, node.val().len));
+    }
+  };
+  put_str(key_method);
+  put_str(key_uri);
+  fmt::format_to(std::back_inserter(line),
+                 ",\"code\":{},\"rtt\":{:.3f},\"sent\":{},\"received\":{}}}",
+                 resRC.code,
+                 rtt / 1000000.0,
+                 sent_bytes_,
+                 resRC.body.size());
+  ctx.event_writer_.write(std::move(line));
+}
+
 // ------------
 // --- HTTP ---
 // ------------
@@ -470,6 +627,8 @@ int request::prepare_http_req(const char *method,
                               std::string &uri_out,
                               RestClient::HeaderFields &reqHF)
 {
+  sent_bytes_ = data ? data->size() : 0;
+
   if(auth == AUTH_AWS_V2) {
     parent_.auth_.x_amz_date_ = utils::aws_auth::aws_sign_v2_build_date();
     parent_.auth_.aws_sign_v2_build(method, uri_out, reqHF);
@@ -481,7 +640,8 @@ int request::prepare_http_req(const char *method,
                                     data,
                                     reqHF);
   }
-  conv_conn_->SetHeaders(reqHF);
+  conv_conn_->set_headers(reqHF);
+  conv_conn_->set_throttle(throttle_);
   dump_hdr(reqHF);
 
   if(query_string && query_string != "") {
@@ -650,6 +810,29 @@ void request::dump_hdr(const RestClient::HeaderFields &hdr) const
   });
 }
 
+std::optional<std::string> request::eval_field(const request_plan::field &fld,
+                                              ryml::NodeRef request_in,
+                                              const char *key,
+                                              bool *is_error)
+{
+  switch(fld.kind) {
+    case request_plan::literal:
+      return fld.value;
+    case request_plan::templated:
+      return scen_p_evaluator_.eval_as<std::string>(request_in,
+                                                    key,
+                                                    scen_out_p_resolv_);
+    case request_plan::scripted:
+      return js_env_.eval_as<std::string>(request_in,
+                                          key,
+                                          std::nullopt,
+                                          !is_error,
+                                          is_error);
+    default:
+      return std::nullopt;
+  }
+}
+
 int request::mocked_to_res(RestClient::Response &resRC)
 {
   bool further_eval = false;
@@ -660,7 +843,7 @@ int request::mocked_to_res(RestClient::Response &resRC)
                                        std::nullopt,
                                        true,
                                        nullptr,
-                                       PROP_EVAL_RGX,
+                                       true,
                                        &further_eval);
   if(!code) {
     if(further_eval) {
@@ -683,7 +866,7 @@ int request::mocked_to_res(RestClient::Response &resRC)
                                            std::nullopt,
                                            true,
                                            nullptr,
-                                           PROP_EVAL_RGX,
+                                           true,
                                            &further_eval);
   if(!body) {
     if(further_eval) {
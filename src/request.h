@@ -9,11 +9,13 @@ struct request {
     int reset(const std::string &raw_host,
               ryml::NodeRef request_in);
 
+    //plan, when given, overrides the one compiled for request_in
     int process(const std::string &raw_host,
                 ryml::NodeRef request_in,
-                ryml::NodeRef requests_out);
+                ryml::NodeRef requests_out,
+                const request_plan *plan = nullptr);
 
-    int execute(const std::string &method,
+    int execute(utils::http_method method,
                 const std::optional<std::string> &auth,
                 const std::string &uri,
                 const std::optional<std::string> &query_string,
@@ -31,6 +33,39 @@ struct request {
                          ryml::NodeRef response_in,
                          ryml::NodeRef response_out);
 
+    //queues the ndjson event line of a completed request
+    void write_event(const RestClient::Response &resRC,
+                     const int64_t rtt,
+                     ryml::ConstNodeRef request_out);
+
+    // -----------------
+    // --- AGGREGATE ---
+    // -----------------
+
+    //the iterations of a 'for' summarized in a single node
+    struct aggregate {
+      void reset();
+      void record(utils::interner::handle code_key,
+                  int32_t code,
+                  int64_t rtt);
+
+      uint32_t count_ = 0;
+      uint32_t failed_ = 0;
+      std::unordered_map<utils::interner::handle, uint32_t> categorization_;
+
+      //response round trip times in nanoseconds
+      utils::histogram rtt_hist_;
+
+      //the current iteration failed at transport level or with a 5xx code
+      bool iteration_failed_ = false;
+    };
+
+    //keeps the first and the first failed iteration as samples
+    void sample_iteration(uint32_t i,
+                          bool failed);
+
+    void render_aggregate(ryml::NodeRef aggregate_out);
+
     // ------------
     // --- HTTP ---
     // ------------
@@ -95,6 +130,11 @@ struct request {
     // --- UTILS ---
     // -------------
 
+    std::optional<std::string> eval_field(const request_plan::field &fld,
+                                          ryml::NodeRef request_in,
+                                          const char *key,
+                                          bool *is_error = nullptr);
+
     void dump_hdr(const RestClient::HeaderFields &hdr) const;
     int mocked_to_res(RestClient::Response &resRC);
 
@@ -114,8 +154,11 @@ struct request {
     //scenario property evaluator
     scenario_property_evaluator &scen_p_evaluator_;
 
-    //map holding nodes with an explicit id set
-    std::unordered_map<std::string, ryml::ConstNodeRef> &indexed_nodes_map_;
+    //ids and category keys
+    utils::interner &interner_;
+
+    //map holding nodes with an explicit id set, by interned id
+    std::unordered_map<utils::interner::handle, ryml::ConstNodeRef> &indexed_nodes_map_;
 
     //js environment
     js::js_env &js_env_;
@@ -126,8 +169,30 @@ struct request {
     //current response mock
     ryml::NodeRef response_mock_;
 
-    //request connection
-    std::unique_ptr<RestClient::Connection> conv_conn_;
+    //plan compiled on the fly, for a request-in outside the scenario's plan
+    request_plan local_plan_;
+
+    //bandwidth throttling
+    utils::throttle throttle_;
+
+    //bytes sent with the current request
+    size_t sent_bytes_ = 0;
+
+    //the evaluated id of the current request
+    std::optional<std::string> id_;
+
+    //aggregated iterations: each one is rendered into iteration_out_,
+    //samples_ holds the first and the first failed one
+    bool aggregating_ = false;
+    aggregate aggregate_;
+    ryml::Tree iteration_out_;
+    ryml::Tree samples_;
+
+    //host of the request connection
+    std::string raw_host_;
+
+    //request connection, owned by the scenario
+    utils::http_connection *conv_conn_ = nullptr;
 };
 
 }
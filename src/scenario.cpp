@@ -1,4 +1,4 @@
-#include "conversation.h"
+#include "search.h"
 
 #define ERR_PUSH_OUT_OPTS       "failed to push the out options in the current scope"
 #define ERR_POP_OUT_OPTS        "failed to process the out options in the current scope"
@@ -10,20 +10,196 @@
 #define ERR_NO_SUCH_REQ         "no such 'requests'"
 #define ERR_FAIL_READ_ENABLED   "failed to read 'enabled'"
 #define ERR_MALFORMED_YAML_PATH "malformed yaml path"
-#define ERR_IDX_NOT_NUMERIC     "non-numeric index"
 #define ERR_IDX_OUT_OF_BOUNDS   "index out bounds"
-#define ERR_UNEXPECTED_TKN      "unexpected token"
 
 namespace cbox {
 
+// ------------------------------
+// --- SCENARIO PROPERTY PATH ---
+// ------------------------------
+
+static constexpr utils::delim_set rpr_delimits(".[]");
+static constexpr utils::delim_set field_delimits(".");
+
+// .[conversation_idx][request_idx].
+static bool is_quick_access(const std::string &path)
+{
+  if(path.empty() || path[0] != '.') {
+    return false;
+  }
+  size_t pos = 1;
+  for(int i = 0; i < 2; ++i) {
+    if(pos >= path.size() || path[pos] != '[') {
+      return false;
+    }
+    size_t digits = ++pos;
+    while(pos < path.size() && std::isdigit((unsigned char)path[pos])) {
+      ++pos;
+    }
+    if(pos == digits || pos >= path.size() || path[pos] != ']') {
+      return false;
+    }
+    ++pos;
+  }
+  return pos < path.size();
+}
+
+void scenario_property_path::compile(const std::string &path)
+{
+  utils::sv_tok tknz(path, rpr_delimits);
+  std::string_view tkn;
+  steps_.clear();
+  query_ = false;
+
+  if(is_quick_access(path)) {
+    //quick access path syntax
+    root_ = quick;
+    tknz.next_token(tkn);
+    auto conv_idx = utils::parse<size_t>(tkn);
+    tknz.next_token(tkn);
+    auto req_idx = utils::parse<size_t>(tkn);
+    tknz.next_token(tkn, true);
+    if(!conv_idx || !req_idx) {
+      steps_.push_back({bad_index, "", 0});
+      return;
+    }
+    conv_idx_ = *conv_idx;
+    req_idx_ = *req_idx;
+  } else if(!path.empty() && path[0] == '.') {
+    //regular path
+    root_ = root;
+  } else {
+    //explicit id path
+    if(!tknz.next_token(tkn)) {
+      root_ = empty;
+      return;
+    }
+    root_ = id;
+    id_.assign(tkn);
+  }
+
+  bool chase_prop = false, chase_idx = false;
+  bool is_delimit;
+  while(tknz.next_token(tkn, true, &is_delimit)) {
+    if(!chase_prop && !chase_idx) {
+      if(tkn == ".") {
+        chase_prop = true;
+        continue;
+      } else if(tkn == "[") {
+        //query subscripts are scanned raw, a filter may hold delimiters
+        size_t pos = tknz.position();
+        if(pos < path.size() && (path[pos] == '*' || path[pos] == '?' || path[pos] == '-')) {
+          size_t close = path.find(']', pos);
+          if(close == std::string::npos || !compile_query(std::string_view(path).substr(pos, close - pos))) {
+            steps_.push_back({bad_index, "", 0});
+            return;
+          }
+          tknz.seek(close + 1);
+          continue;
+        }
+        chase_idx = true;
+        continue;
+      } else {
+        steps_.push_back({bad_key, "", 0});
+        return;
+      }
+    }
+    if(chase_prop) {
+      if(is_delimit) {
+        steps_.push_back({bad_key, "", 0});
+        return;
+      }
+      steps_.push_back({by_key, std::string(tkn), 0});
+      chase_prop = false;
+      continue;
+    }
+    if(chase_idx) {
+      auto idx = is_delimit ? std::nullopt : utils::parse<size_t>(tkn);
+      if(!idx) {
+        steps_.push_back({bad_index, "", 0});
+        return;
+      }
+      if(!tknz.next_token(tkn, true) || tkn != "]") {
+        steps_.push_back({bad_index, "", 0});
+        return;
+      }
+      steps_.push_back({by_index, "", *idx});
+      chase_idx = false;
+      continue;
+    }
+  }
+  if(chase_prop) {
+    steps_.push_back({bad_key, "", 0});
+  } else if(chase_idx) {
+    steps_.push_back({bad_index, "", 0});
+  }
+}
+
+static std::string_view trim_sv(std::string_view str)
+{
+  size_t first = str.find_first_not_of(" \t");
+  if(first == std::string_view::npos) {
+    return std::string_view();
+  }
+  return str.substr(first, str.find_last_not_of(" \t") - first + 1);
+}
+
+bool scenario_property_path::compile_query(std::string_view subscript)
+{
+  if(subscript == "*") {
+    steps_.push_back({all, "", 0});
+    query_ = true;
+    return true;
+  }
+
+  if(subscript[0] == '-') {
+    auto idx = utils::parse<size_t>(subscript.substr(1));
+    if(!idx || !*idx) {
+      return false;
+    }
+    steps_.push_back({by_rindex, "", *idx});
+    return true;
+  }
+
+  //?field==value or ?field!=value
+  subscript.remove_prefix(1);
+  step stp{filter_eq, "", 0};
+  size_t op = subscript.find("==");
+  size_t op_ne = subscript.find("!=");
+  if(op_ne < op) {
+    op = op_ne;
+    stp.kind = filter_ne;
+  }
+  if(op == std::string_view::npos) {
+    return false;
+  }
+
+  std::string_view value = trim_sv(subscript.substr(op + 2));
+  if(value.size() >= 2 && (value[0] == '\'' || value[0] == '"') && value.back() == value[0]) {
+    value = value.substr(1, value.size() - 2);
+  }
+  stp.key.assign(value);
+
+  std::string_view field = trim_sv(subscript.substr(0, op));
+  utils::sv_tok tknz(field, field_delimits);
+  std::string_view tkn;
+  while(tknz.next_token(tkn)) {
+    stp.field.emplace_back(tkn);
+  }
+  if(stp.field.empty()) {
+    return false;
+  }
+  stp.field_key.assign(field);
+
+  steps_.push_back(std::move(stp));
+  query_ = true;
+  return true;
+}
+
 // ----------------------------------
 // --- SCENARIO PROPERTY RESOLVER ---
 // ----------------------------------
 
-// .[conversation_idx][request_idx].
-const char *quick_conv_req_access_syntax_rgx = "^(?:.\\[[0-9]{1,}\\]\\[[0-9]{1,}\\].)(.*)$";
-const char *rpr_delimits = ".[]";
-
 int scenario_property_resolver::init(std::shared_ptr<spdlog::logger> &event_log)
 {
   event_log_ = event_log;
@@ -33,183 +209,349 @@ int scenario_property_resolver::init(std::shared_ptr<spdlog::logger> &event_log)
 int scenario_property_resolver::reset(ryml::ConstNodeRef scenario_obj_root)
 {
   scenario_obj_root_ = scenario_obj_root;
+  indexes_.clear();
+
+  //compiled paths cache interned ids
+  paths_.clear();
   return 0;
 }
 
-bool is_number(const std::string &s)
+const scenario_property_path &scenario_property_resolver::get_path(const std::string &path) const
 {
-  return !s.empty() && std::find_if(s.begin(),
-  s.end(), [](unsigned char c) {
-    return !std::isdigit(c);
-  }) == s.end();
+  auto it = paths_.find(path);
+  if(it == paths_.end()) {
+    it = paths_.emplace(path, scenario_property_path()).first;
+    it->second.compile(path);
+  }
+  return it->second;
 }
 
 std::optional<ryml::ConstNodeRef> scenario_property_resolver::resolve(const std::string &path) const
 {
-  utils::str_tok tknz(path);
-  ryml::ConstNodeRef from;
+  return resolve(get_path(path));
+}
 
-  if(std::regex_search(path, std::regex(quick_conv_req_access_syntax_rgx))) {
-    //quick access path syntax
+std::optional<ryml::ConstNodeRef> scenario_property_resolver::resolve(const scenario_property_path &cpath) const
+{
+  auto from = resolve_root(cpath);
+  if(!from) {
+    return std::nullopt;
+  }
+  return resolve_common(*from, cpath);
+}
 
-    if(!scenario_obj_root_.has_child(key_conversations)) {
-      event_log_->error(ERR_NO_SUCH_CONV);
-      return std::nullopt;
-    }
+bool scenario_property_resolver::render(const std::string &path,
+                                        std::string &out) const
+{
+  const scenario_property_path &cpath = get_path(path);
+  auto from = resolve_root(cpath);
+  if(!from) {
+    return false;
+  }
 
-    auto convs_ref = scenario_obj_root_[key_conversations];
-    if(!convs_ref.is_seq()) {
-      event_log_->error(ERR_CONV_NOT_SEQ);
-      return std::nullopt;
+  if(!cpath.query_) {
+    auto node_ref = resolve_common(*from, cpath);
+    if(!node_ref || !((*node_ref).is_keyval() || (*node_ref).is_val())) {
+      return false;
     }
+    ryml::csubstr node_val = (*node_ref).val();
+    out.append(node_val.str, node_val.len);
+    return true;
+  }
 
-    std::string tkn;
-    if(!tknz.next_token(tkn, rpr_delimits)) {
-      return std::nullopt;
-    }
-    if(!is_number(tkn)) {
-      event_log_->error(ERR_IDX_NOT_NUMERIC);
-      return std::nullopt;
+  //a query selecting nothing fails as a missing path does
+  std::vector<ryml::ConstNodeRef> nodes;
+  resolve_query(*from, cpath, 0, nodes);
+  if(nodes.empty()) {
+    return false;
+  }
+  for(size_t i = 0; i < nodes.size(); ++i) {
+    if(!(nodes[i].is_keyval() || nodes[i].is_val())) {
+      return false;
     }
-    uint32_t idx = 0;
-    {
-      std::stringstream ss;
-      ss << tkn;
-      ss >> idx;
+    if(i) {
+      out += ',';
     }
+    ryml::csubstr node_val = nodes[i].val();
+    out.append(node_val.str, node_val.len);
+  }
+  return true;
+}
 
-    if(idx >= convs_ref.num_children()) {
-      event_log_->error(ERR_IDX_OUT_OF_BOUNDS);
-      return std::nullopt;
-    }
+std::optional<ryml::ConstNodeRef> scenario_property_resolver::resolve_root(const scenario_property_path &cpath) const
+{
+  ryml::ConstNodeRef from;
 
-    auto conv_ref = convs_ref[idx];
-    if(!conv_ref.has_child(key_requests)) {
-      event_log_->error(ERR_NO_SUCH_REQ);
-      return std::nullopt;
-    }
+  switch(cpath.root_) {
+    case scenario_property_path::quick: {
+      if(!scenario_obj_root_.has_child(key_conversations)) {
+        event_log_->error(ERR_NO_SUCH_CONV);
+        return std::nullopt;
+      }
 
-    auto reqs_ref = conv_ref[key_requests];
-    if(!reqs_ref.is_seq()) {
-      event_log_->error(ERR_REQ_NOT_SEQ);
-      return std::nullopt;
-    }
+      auto convs_ref = scenario_obj_root_[key_conversations];
+      if(!convs_ref.is_seq()) {
+        event_log_->error(ERR_CONV_NOT_SEQ);
+        return std::nullopt;
+      }
+      if(cpath.conv_idx_ >= convs_ref.num_children()) {
+        event_log_->error(ERR_IDX_OUT_OF_BOUNDS);
+        return std::nullopt;
+      }
 
-    if(!tknz.next_token(tkn, rpr_delimits)) {
-      return std::nullopt;
+      auto conv_ref = convs_ref[cpath.conv_idx_];
+      if(!conv_ref.has_child(key_requests)) {
+        event_log_->error(ERR_NO_SUCH_REQ);
+        return std::nullopt;
+      }
+
+      auto reqs_ref = conv_ref[key_requests];
+      if(!reqs_ref.is_seq()) {
+        event_log_->error(ERR_REQ_NOT_SEQ);
+        return std::nullopt;
+      }
+      if(cpath.req_idx_ >= reqs_ref.num_children()) {
+        event_log_->error(ERR_IDX_OUT_OF_BOUNDS);
+        return std::nullopt;
+      }
+      from = reqs_ref[cpath.req_idx_];
+      break;
+    }
+    case scenario_property_path::root:
+      from = scenario_obj_root_;
+      break;
+    case scenario_property_path::id: {
+      if(!cpath.id_handle_) {
+        cpath.id_handle_ = parent_.interner_.find(cpath.id_);
+        if(!cpath.id_handle_) {
+          return std::nullopt;
+        }
+      }
+      auto id_it = parent_.indexed_nodes_map_.find(*cpath.id_handle_);
+      if(id_it == parent_.indexed_nodes_map_.end()) {
+        return std::nullopt;
+      }
+      from = id_it->second;
+      break;
     }
-    if(!is_number(tkn)) {
-      event_log_->error(ERR_IDX_NOT_NUMERIC);
+    default:
       return std::nullopt;
+  }
+  return from;
+}
+
+std::optional<ryml::ConstNodeRef> scenario_property_resolver::resolve_common(ryml::ConstNodeRef from,
+                                                                             const scenario_property_path &cpath) const
+{
+  for(const auto &stp : cpath.steps_) {
+    switch(stp.kind) {
+      case scenario_property_path::by_key:
+        if(!from.has_child(ryml::to_csubstr(stp.key))) {
+          return std::nullopt;
+        }
+        from = from[ryml::to_csubstr(stp.key)];
+        break;
+      case scenario_property_path::by_index:
+        if(!from.is_seq() || stp.idx >= from.num_children()) {
+          return std::nullopt;
+        }
+        from = from[stp.idx];
+        break;
+      case scenario_property_path::by_rindex:
+        if(!from.is_seq() || stp.idx > from.num_children()) {
+          return std::nullopt;
+        }
+        from = from[from.num_children() - stp.idx];
+        break;
+      case scenario_property_path::bad_index:
+        if(!from.is_seq()) {
+          return std::nullopt;
+        }
+        event_log_->error(ERR_MALFORMED_YAML_PATH);
+        return std::nullopt;
+      default:
+        event_log_->error(ERR_MALFORMED_YAML_PATH);
+        return std::nullopt;
     }
-    {
-      std::stringstream ss;
-      ss << tkn;
-      ss >> idx;
+  }
+  return from;
+}
+
+void scenario_property_resolver::resolve_query(ryml::ConstNodeRef from,
+                                               const scenario_property_path &cpath,
+                                               size_t step_idx,
+                                               std::vector<ryml::ConstNodeRef> &out) const
+{
+  for(; step_idx < cpath.steps_.size(); ++step_idx) {
+    const auto &stp = cpath.steps_[step_idx];
+    switch(stp.kind) {
+      case scenario_property_path::by_key:
+        if(!from.has_child(ryml::to_csubstr(stp.key))) {
+          return;
+        }
+        from = from[ryml::to_csubstr(stp.key)];
+        break;
+      case scenario_property_path::by_index:
+        if(!from.is_seq() || stp.idx >= from.num_children()) {
+          return;
+        }
+        from = from[stp.idx];
+        break;
+      case scenario_property_path::by_rindex:
+        if(!from.is_seq() || stp.idx > from.num_children()) {
+          return;
+        }
+        from = from[from.num_children() - stp.idx];
+        break;
+      case scenario_property_path::all:
+      case scenario_property_path::filter_eq:
+      case scenario_property_path::filter_ne: {
+        std::vector<ryml::ConstNodeRef> selected;
+        if(stp.kind == scenario_property_path::all) {
+          for(ryml::ConstNodeRef const &child : from.children()) {
+            selected.push_back(child);
+          }
+        } else if(from.is_seq()) {
+          filter(from, stp, selected);
+        }
+
+        //an index right after a selection picks from the selection: [?code==200][-1]
+        size_t next = step_idx + 1;
+        if(next < cpath.steps_.size()) {
+          const auto &nstp = cpath.steps_[next];
+          if(nstp.kind == scenario_property_path::by_index ||
+              nstp.kind == scenario_property_path::by_rindex) {
+            size_t count = selected.size();
+            if(nstp.kind == scenario_property_path::by_index ? nstp.idx >= count : nstp.idx > count) {
+              return;
+            }
+            resolve_query(selected[nstp.kind == scenario_property_path::by_index ? nstp.idx : count - nstp.idx],
+                          cpath,
+                          next + 1,
+                          out);
+            return;
+          }
+        }
+        for(ryml::ConstNodeRef const &child : selected) {
+          resolve_query(child, cpath, next, out);
+        }
+        return;
+      }
+      default:
+        event_log_->error(ERR_MALFORMED_YAML_PATH);
+        return;
     }
+  }
+  out.push_back(from);
+}
 
-    if(idx >= reqs_ref.num_children()) {
-      event_log_->error(ERR_IDX_OUT_OF_BOUNDS);
+static std::optional<ryml::csubstr> field_value(ryml::ConstNodeRef node,
+                                                const std::vector<std::string> &field)
+{
+  for(const auto &key : field) {
+    if(!node.is_map() || !node.has_child(ryml::to_csubstr(key))) {
       return std::nullopt;
     }
+    node = node[ryml::to_csubstr(key)];
+  }
+  if(!(node.is_keyval() || node.is_val())) {
+    return std::nullopt;
+  }
+  return node.val();
+}
 
-    if(!tknz.next_token(tkn, rpr_delimits, true) || tkn != "]") {
-      event_log_->error(ERR_UNEXPECTED_TKN);
-      return std::nullopt;
+void scenario_property_resolver::filter(ryml::ConstNodeRef seq,
+                                        const scenario_property_path::step &stp,
+                                        std::vector<ryml::ConstNodeRef> &out) const
+{
+  const ryml::Tree *tree = seq.tree();
+  ryml::csubstr value = ryml::to_csubstr(stp.key);
+
+  //only requests sequences grow by appending sealed children: any other is scanned live
+  if(stp.kind == scenario_property_path::filter_ne ||
+      seq.num_children() < 2 ||
+      !seq.has_key() ||
+      seq.key() != key_requests) {
+    for(ryml::ConstNodeRef const &child : seq.children()) {
+      auto fv = field_value(child, stp.field);
+      if(fv && ((*fv == value) == (stp.kind == scenario_property_path::filter_eq))) {
+        out.push_back(child);
+      }
     }
-    from = reqs_ref[idx];
-  } else if(path[0] == '.') {
-    //regular path
-    from = scenario_obj_root_;
-  } else {
-    //explicit id path
-    std::string tkn;
-    if(!tknz.next_token(tkn, rpr_delimits)) {
-      return std::nullopt;
+    return;
+  }
+
+  field_index &fidx = indexes_[tree][seq.id()][stp.field_key];
+
+  //a requests sequence was cleared since it was indexed
+  if(fidx.generation != generation_) {
+    fidx = field_index();
+    fidx.generation = generation_;
+  }
+
+  //index the sealed children not indexed yet
+  size_t last = seq.last_child().id();
+  size_t it = fidx.indexed ? tree->next_sibling(fidx.last_id) : tree->first_child(seq.id());
+  for(; it != ryml::NONE && it != last; it = tree->next_sibling(it)) {
+    auto fv = field_value(ryml::ConstNodeRef(tree, it), stp.field);
+    if(fv) {
+      fidx.ids[std::string(fv->str, fv->len)].push_back(it);
     }
-    auto it = parent_.indexed_nodes_map_.find(tkn);
-    if(it == parent_.indexed_nodes_map_.end()) {
-      return std::nullopt;
+    fidx.last_id = it;
+    ++fidx.indexed;
+  }
+
+  auto hit = fidx.ids.find(stp.key);
+  if(hit != fidx.ids.end()) {
+    for(size_t id : hit->second) {
+      out.emplace_back(tree, id);
     }
-    from = it->second;
   }
 
-  return resolve_common(from, tknz);
+  //the last child is matched live
+  auto fv = field_value(seq.last_child(), stp.field);
+  if(fv && *fv == value) {
+    out.push_back(seq.last_child());
+  }
 }
 
-std::optional<ryml::ConstNodeRef> scenario_property_resolver::resolve_common(ryml::ConstNodeRef from,
-                                                                             utils::str_tok &tknz) const
+// ----------------------------------
+// --- SCENARIO PROPERTY TEMPLATE ---
+// ----------------------------------
+
+void scenario_property_template::compile(ryml::csubstr source)
 {
-  std::string tkn;
-  bool chase_prop = false, chase_idx = false;
+  source_.assign(source.str, source.len);
+  segments_.clear();
 
-  bool is_delimit;
-  while(tknz.next_token(tkn, rpr_delimits, true, &is_delimit)) {
-    if(!chase_prop && !chase_idx) {
-      if(tkn == ".") {
-        chase_prop = true;
-        continue;
-      } else if(tkn == "[") {
-        if(!from.is_seq()) {
-          goto fin_null;
-        }
-        chase_idx = true;
-        continue;
-      } else {
-        goto fin_malformed;
-      }
+  size_t from = 0, open, close;
+  while(utils::find_placeholder(source, from, open, close)) {
+    if(open > from) {
+      segments_.push_back({text, std::string(source.str + from, open - from)});
     }
-    if(chase_prop) {
-      if(is_delimit) {
-        goto fin_malformed;
-      }
-      if(!from.has_child(ryml::to_csubstr(tkn.c_str()))) {
-        goto fin_null;
+    std::string path(source.str + open + 2, close - open - 4);
+    utils::trim(path);
+    if(!path.empty() && path[0] == '=') {
+      segment seg{expr};
+      if(!seg.expr.compile(std::string_view(path).substr(1), seg.text)) {
+        seg.kind = bad_expr;
+        seg.text = fmt::format("{}:{}", seg.text, path);
       }
-      from = from[ryml::to_csubstr(tkn.c_str())];
-      chase_prop = false;
-      continue;
-    }
-    if(chase_idx) {
-      if(is_delimit) {
-        goto fin_malformed;
-      }
-      if(!is_number(tkn)) {
-        goto fin_malformed;
-      }
-      std::stringstream ss;
-      ss << tkn;
-      uint32_t idx;
-      ss >> idx;
-      if(idx >= from.num_children()) {
-        goto fin_null;
-      }
-      from = from[idx];
-      if(!tknz.next_token(tkn, rpr_delimits, true) || tkn != "]") {
-        goto fin_malformed;
-      }
-      chase_idx = false;
-      continue;
+      segments_.push_back(std::move(seg));
+    } else {
+      segments_.push_back({scenario_property_template::path, std::move(path)});
     }
+    from = close;
   }
-  if(chase_prop || chase_idx) {
-    goto fin_malformed;
+  if(from < source.len) {
+    segments_.push_back({text, std::string(source.str + from, source.len - from)});
   }
-  return from;
-
-fin_malformed:
-  event_log_->error(ERR_MALFORMED_YAML_PATH);
-  return std::nullopt;
-fin_null:
-  return std::nullopt;
 }
 
 // -----------------------------------
 // --- SCENARIO PROPERTY EVALUATOR ---
 // -----------------------------------
 
-const char *eval_rgx = "";
-
 int scenario_property_evaluator::init(std::shared_ptr<spdlog::logger> &event_log)
 {
   event_log_ = event_log;
@@ -219,25 +561,80 @@ int scenario_property_evaluator::init(std::shared_ptr<spdlog::logger> &event_log
 int scenario_property_evaluator::reset(ryml::ConstNodeRef scenario_obj_root)
 {
   scenario_obj_root_ = scenario_obj_root;
+  templates_.clear();
   return 0;
 }
 
+const scenario_property_template &scenario_property_evaluator::get_template(ryml::ConstNodeRef n_val)
+{
+  ryml::csubstr source = n_val.has_val() ? n_val.val() : ryml::csubstr();
+  scenario_property_template &tpl = templates_[n_val.tree()][n_val.id()];
+
+  //node ids are recycled when the tree is modified, so the source is checked
+  if(tpl.source_.size() != source.len ||
+      tpl.source_.compare(0, source.len, source.str, source.len)) {
+    tpl.compile(source);
+  }
+  return tpl;
+}
+
+bool scenario_property_evaluator::eval_expr(const scenario_property_template::segment &seg,
+                                            const scenario_property_resolver &spr)
+{
+  std::string error;
+  expression::env env{iteration_, rng_, [&](const std::string &path) -> std::optional<std::string> {
+      std::string val;
+      if(spr.render(path, val)) {
+        return val;
+      }
+      return std::nullopt;
+    }
+  };
+
+  if(!seg.expr.eval(env, expr_val_, error)) {
+    event_log_->error("{}:{}", ERR_FAIL_EVAL, error);
+    return false;
+  }
+  return true;
+}
+
+bool scenario_property_evaluator::render(const scenario_property_template &tpl,
+                                         const scenario_property_resolver &spr)
+{
+  render_buf_.clear();
+  for(const auto &seg : tpl.segments_) {
+    switch(seg.kind) {
+      case scenario_property_template::text:
+        render_buf_ += seg.text;
+        break;
+      case scenario_property_template::path:
+        if(!spr.render(seg.text, render_buf_)) {
+          return false;
+        }
+        break;
+      case scenario_property_template::expr:
+        if(!eval_expr(seg, spr)) {
+          return false;
+        }
+        render_buf_ += expr_val_.as_string();
+        break;
+      default:
+        event_log_->error("{}:{}", ERR_FAIL_EVAL, seg.text);
+        return false;
+    }
+  }
+  return true;
+}
+
 // -------------------
 // --- STACK SCOPE ---
 // -------------------
 
-// *INDENT-OFF*
 scenario::stack_scope::stack_scope(scenario &parent,
                                    ryml::NodeRef obj_in,
                                    ryml::NodeRef obj_out,
                                    bool &error,
-                                   const ryml::Tree &default_out_options,
-                                   bool call_dump_val_cb,
-                                   const std::function<void(const std::string &key, bool val)> &dump_val_cb,
-                                   bool call_format_val_cb,
-                                   const std::function<void(const std::string &key, const std::string &val)> &format_val_cb)
-// *INDENT-ON*
-  :
+                                   const utils::out_options &default_out_options) :
   parent_(parent),
   obj_in_(obj_in),
   obj_out_(obj_out),
@@ -245,11 +642,7 @@ scenario::stack_scope::stack_scope(scenario &parent,
   enabled_(false),
   commit_(false)
 {
-  if(!push_out_opts(default_out_options,
-                    call_dump_val_cb,
-                    dump_val_cb,
-                    call_format_val_cb,
-                    format_val_cb)) {
+  if(!push_out_opts(default_out_options)) {
     parent_.event_log_->error(ERR_PUSH_OUT_OPTS);
     utils::clear_map_node_put_key_val(obj_out_, key_error, ERR_PUSH_OUT_OPTS);
     error_ = true;
@@ -300,126 +693,56 @@ scenario::stack_scope::~stack_scope()
   }
 }
 
-bool scenario::stack_scope::push_out_opts(const ryml::Tree &default_out_options,
-                                          bool call_dump_val_cb,
-                                          const std::function<void(const std::string &key, bool val)> &dump_val_cb,
-                                          bool call_format_val_cb,
-                                          const std::function<void(const std::string &key, const std::string &val)> &format_val_cb)
+bool scenario::stack_scope::push_out_opts(const utils::out_options &default_out_options)
 {
-  bool res = true;
-
-  out_opts_ = default_out_options;
-  ryml::NodeRef out_opts_root = out_opts_.rootref();
-  ryml::NodeRef out_node;
-
-  if(obj_out_.has_child(key_out)) {
-    out_node = obj_out_[key_out];
-
-    if(out_node.has_child(key_dump)) {
-      ryml::NodeRef out_opts_dump_node = out_opts_root[key_dump];
-      ryml::NodeRef dump_node = out_node[key_dump];
-      for(ryml::ConstNodeRef const &dn_c : dump_node.children()) {
-        if(out_opts_dump_node.has_child(dn_c.key())) {
-          out_opts_dump_node.remove_child(dn_c.key());
-        }
-      }
-      for(ryml::ConstNodeRef const &dn_c : out_opts_dump_node.children()) {
-        if(out_opts_dump_node.has_child(dn_c.key())) {
-          dump_node[dn_c.key()] << dn_c.val();
-        }
-      }
-    } else {
-      ryml::NodeRef dump_node = out_node[key_dump];
-      utils::set_tree_node(out_opts_,
-                           out_opts_root[key_dump],
-                           dump_node,
-                           parent_.ryml_scenario_out_buf_);
-    }
-
-    if(out_node.has_child(key_format)) {
-      ryml::NodeRef out_opts_format_node = out_opts_root[key_format];
-      ryml::NodeRef format_node = out_node[key_format];
-      for(ryml::ConstNodeRef const &dn_c : format_node.children()) {
-        if(out_opts_format_node.has_child(dn_c.key())) {
-          out_opts_format_node.remove_child(dn_c.key());
-        }
-      }
-      for(ryml::ConstNodeRef const &dn_c : out_opts_format_node.children()) {
-        if(out_opts_format_node.has_child(dn_c.key())) {
-          format_node[dn_c.key()] << dn_c.val();
-        }
+  if(!obj_out_.has_child(key_out)) {
+    out_opts_ = &default_out_options;
+  } else {
+    ryml::ConstNodeRef out_node = obj_out_[key_out];
+
+    //an out node read as written is the copy of its input's:
+    //resolved once per input node, however many times it is iterated
+    if(parent_.plan_.static_out(obj_in_)) {
+      auto it = parent_.out_opts_cache_.find(obj_in_.id());
+      if(it == parent_.out_opts_cache_.end()) {
+        it = parent_.out_opts_cache_.emplace(obj_in_.id(), default_out_options).first;
+        it->second.merge(out_node);
       }
+      out_opts_ = &it->second;
     } else {
-      ryml::NodeRef format_node = out_node[key_format];
-      utils::set_tree_node(out_opts_,
-                           out_opts_root[key_format],
-                           format_node,
-                           parent_.ryml_scenario_out_buf_);
-    }
-
-  } else {
-    out_node = obj_out_[key_out];
-    out_node |= ryml::MAP;
-    utils::set_tree_node(out_opts_,
-                         out_opts_root,
-                         out_node,
-                         parent_.ryml_scenario_out_buf_);
-  }
-
-  out_opts_root.clear();
-  out_opts_root |= ryml::MAP;
-
-  utils::set_tree_node(*out_node.tree(),
-                       out_node[key_dump],
-                       out_opts_root,
-                       parent_.ryml_scenario_out_buf_);
-
-  utils::set_tree_node(*out_node.tree(),
-                       out_node[key_format],
-                       out_opts_root,
-                       parent_.ryml_scenario_out_buf_);
-
-  if(call_dump_val_cb) {
-    ryml::NodeRef dump_node = out_node[key_dump];
-    for(ryml::ConstNodeRef const &dn_c : dump_node.children()) {
-      std::ostringstream os;
-      os << dn_c.key();
-      std::string val;
-      dn_c >> val;
-      dump_val_cb(os.str(), (val == STR_TRUE));
-    }
-  }
-  if(call_format_val_cb) {
-    ryml::NodeRef format_node = out_node[key_format];
-    for(ryml::ConstNodeRef const &dn_c : format_node.children()) {
-      std::ostringstream os;
-      os << dn_c.key();
-      std::string val;
-      dn_c >> val;
-      format_val_cb(os.str(), val);
+      own_out_opts_ = default_out_options;
+      own_out_opts_.merge(out_node);
+      out_opts_ = &own_out_opts_;
     }
   }
 
-  return res;
+  //the options in effect are rendered only when out itself is
+  if(out_opts_->dumps(utils::out_options::dump_out)) {
+    ryml::NodeRef out_node = obj_out_[key_out];
+    out_opts_->render(out_node);
+  }
+  return true;
 }
 
 bool scenario::stack_scope::pop_process_out_opts()
 {
-  bool res = true;
-  ryml::NodeRef out_opts_root = out_opts_.rootref();
-  if(out_opts_root.has_child(key_dump)) {
-    ryml::NodeRef out_opts_dump_node = out_opts_root[key_dump];
-    std::string val;
-    for(ryml::ConstNodeRef const &dn_c : out_opts_dump_node.children()) {
-      dn_c >> val;
-      if(val == STR_FALSE) {
-        if(obj_out_.has_child(dn_c.key())) {
-          obj_out_.remove_child(dn_c.key());
-        }
+  for(const auto &it : out_opts_->dump_) {
+    if(!it.second) {
+      ryml::csubstr key(it.first.data(), it.first.size());
+      if(obj_out_.has_child(key)) {
+        obj_out_.remove_child(key);
       }
     }
   }
-  return res;
+  return true;
+}
+
+bool scenario::stack_scope::dumps(utils::out_options::dump_key key) const
+{
+  if(parent_.ctx_.cfg_.no_out_) {
+    return false;
+  }
+  return out_opts_->dumps(key);
 }
 
 // -------------
@@ -431,6 +754,9 @@ void scenario::statistics::reset()
   conversation_count_ = 0;
   request_count_ = 0;
   categorization_.clear();
+  error_count_ = 0;
+  rtt_hist_.reset();
+  connections_.clear();
 }
 
 void scenario::statistics::incr_conversation_count()
@@ -443,12 +769,41 @@ void scenario::statistics::incr_request_count()
   ++request_count_;
 }
 
-void scenario::statistics::incr_categorization(const std::string &key)
+void scenario::statistics::incr_categorization(utils::interner::handle key)
 {
   auto value = categorization_[key];
   categorization_[key] = ++value;
 }
 
+void scenario::statistics::record_response(int32_t code, int64_t rtt)
+{
+  if(code < 100 || code >= 500) {
+    ++error_count_;
+  }
+  rtt_hist_.record(rtt > 0 ? (uint64_t)rtt : 0);
+}
+
+void scenario::statistics::record_connection(const std::string &host,
+                                             const utils::conn_stats &event)
+{
+  connections_[host].merge(event);
+}
+
+void scenario::statistics::merge(const statistics &other)
+{
+  conversation_count_ += other.conversation_count_;
+  request_count_ += other.request_count_;
+  //handles are local to a scenario, so the other's are translated
+  std::for_each(other.categorization_.begin(), other.categorization_.end(), [&](const auto &it) {
+    categorization_[parent_.interner_.intern(other.parent_.interner_.str(it.first))] += it.second;
+  });
+  error_count_ += other.error_count_;
+  rtt_hist_.merge(other.rtt_hist_);
+  std::for_each(other.connections_.begin(), other.connections_.end(), [&](const auto &it) {
+    connections_[it.first].merge(it.second);
+  });
+}
+
 // ----------------
 // --- SCENARIO ---
 // ----------------
@@ -461,7 +816,14 @@ scenario::scenario(context &env) :
 {}
 
 scenario::~scenario()
-{}
+{
+  //the pooled sockets close with the scenario
+  for(const auto &it : conn_open_) {
+    if(it.second) {
+      ctx_.conn_gauge_.close(it.first);
+    }
+  }
+}
 
 int scenario::init(std::shared_ptr<spdlog::logger> &event_log)
 {
@@ -480,6 +842,7 @@ int scenario::init(std::shared_ptr<spdlog::logger> &event_log)
     return res;
   }
 
+  pooled_ = ctx_.cfg_.keep_alive || executor::concurrency(ctx_.cfg_.workers) > 1;
   return res;
 }
 
@@ -489,15 +852,25 @@ int scenario::reset(ryml::Tree &doc_in,
   scenario_in_root_ = scenario_in;
   assert_failure_ = false;
 
-  //clear out & buffers
+  //clear out & buffers, the arena is not cleared along with the nodes
   scenario_out_.clear();
+  scenario_out_.clear_arena();
   ryml_scenario_out_buf_.clear();
 
   indexed_nodes_map_.clear();
+  interner_.clear();
+  out_opts_cache_.clear();
+
+  //a shard never streams, its output is merged by the executor
+  streaming_ = prunable_ = false;
+  stream_conv_idx_ = 0;
 
   // reset stats
   stats_.reset();
 
+  //compile the request plans
+  plan_.compile(scenario_in_root_, ryml_scenario_out_buf_);
+
   //initialize scenario-out
   utils::set_tree_node(doc_in,
                        scenario_in_root_,
@@ -523,7 +896,18 @@ int scenario::process(ryml::Tree &doc_in,
     return res;
   }
 
-  bool error = false;
+  streaming_ = ctx_.cfg_.stream_out_ && !ctx_.cfg_.no_out_ && !ctx_.cfg_.daemon;
+  binary_out_ = codec::format_from(ctx_.cfg_.out_format);
+  prunable_ = streaming_ && !plan_.handlers_ && !plan_.positional_refs_;
+
+  //reserve the scenario-out once, as estimated and corrected by the previous scenarios,
+  //instead of growing it by reallocation while requests are appended
+  size_t est_nodes = 0, est_arena = 0;
+  bool est_exact = plan_.out_capacity(prunable_, est_nodes, est_arena);
+  scenario_out_.reserve(std::min(ctx_.out_hint_.nodes(est_nodes), scenario_plan::reserved_nodes));
+  scenario_out_.reserve_arena(std::min(ctx_.out_hint_.arena(est_arena), scenario_plan::reserved_arena));
+
+  bool error = false, sharded = false;
   ryml::NodeRef scenario_out_root = scenario_out_.rootref();
 
   {
@@ -548,17 +932,42 @@ int scenario::process(ryml::Tree &doc_in,
 
         ryml::NodeRef conversations_out = scenario_out_root[key_conversations];
 
-        uint32_t conv_it = 0;
+        //a concurrency search owns the workers, conversations run sequentially then
+        bool has_search = false;
         for(ryml::NodeRef const &conversation_in : conversations_in.children()) {
+          has_search |= conversation_in.is_map() && conversation_in.has_child(key_search);
+        }
 
-          /*TODO parallel handling*/
-          conversation conv(*this);
-
-          if((res = conv.process(conversation_in,
-                                 conversations_out[conv_it]))) {
-            break;
+        if(!has_search && executor::concurrency(ctx_.cfg_.workers) > 1 && conversations_in.num_children() > 1) {
+          //conversations sharded across worker threads, their output is whole only once merged
+          streaming_ = prunable_ = false;
+          sharded = true;
+          executor exec(*this);
+          res = exec.process_conversations(conversations_in, conversations_out);
+        } else {
+          uint32_t conv_it = 0;
+          for(ryml::NodeRef const &conversation_in : conversations_in.children()) {
+            stream_conv_idx_ = conv_it;
+            if(conversation_in.is_map() && conversation_in.has_child(key_search)) {
+              search srch(*this);
+
+              res = srch.process(conv_it,
+                                 conversation_in,
+                                 conversations_out[conv_it]);
+            } else {
+              conversation conv(*this);
+
+              res = conv.process(conversation_in,
+                                 conversations_out[conv_it]);
+            }
+            if(streaming_) {
+              stream_record(conversations_out[conv_it], false);
+            }
+            if(res) {
+              break;
+            }
+            ++conv_it;
           }
-          ++conv_it;
         }
       }
       if(!res) {
@@ -578,6 +987,17 @@ fun_end:
     scenario_out_root[key_error_occurred] << STR_TRUE;
   }
 
+  //a sharded scenario-out is merged, not grown in place, and a capped estimate
+  //is not meant to match: nothing to learn from either
+  if(!sharded && est_exact) {
+    ctx_.out_hint_.learn(est_nodes, scenario_out_.size(), est_arena, scenario_out_.arena_size());
+  }
+
+  //conversations were streamed, what is left is the scenario's own summary
+  if(streaming_ && scenario_out_root.has_child(key_conversations)) {
+    scenario_out_root.remove_child(key_conversations);
+  }
+
   // finally write scenario_out on the output
   if(!ctx_.cfg_.no_out_) {
     if(!ctx_.cfg_.daemon) {
@@ -585,6 +1005,8 @@ fun_end:
         *ctx_.output_ << YAML_DOC_SEP << std::endl << scenario_out_;
       } else if(ctx_.cfg_.out_format == STR_JSON) {
         *ctx_.output_ << ryml::as_json(scenario_out_);
+      } else if(binary_out_) {
+        write_binary(scenario_out_);
       }
     } else {
       Pistache::Http::Code endpoint_res = res ? Pistache::Http::Code::Internal_Server_Error : Pistache::Http::Code::Ok;
@@ -605,6 +1027,128 @@ fun_end:
   return res;
 }
 
+utils::http_connection &scenario::get_connection(const std::string &raw_host)
+{
+  auto it = connections_.find(raw_host);
+  if(it != connections_.end()) {
+    if(pooled_) {
+      return *it->second;
+    }
+    //a fresh connection per request: the previous one closes its socket
+    bool &open = conn_open_[raw_host];
+    if(open) {
+      ctx_.conn_gauge_.close(raw_host);
+      open = false;
+    }
+    connections_.erase(it);
+  }
+  auto conn = std::make_unique<utils::http_connection>(raw_host);
+  return *connections_.emplace(raw_host, std::move(conn)).first->second;
+}
+
+utils::conn_stats scenario::track_connection(const std::string &raw_host,
+                                             const RestClient::Response &resRC,
+                                             const utils::transfer_info &transfer)
+{
+  utils::conn_stats event;
+  bool &open = conn_open_[raw_host];
+
+  //curl codes are below 100: the request failed at transport level
+  if(resRC.code < 100) {
+    event.errors = 1;
+  }
+  event.created = transfer.connects;
+  if(transfer.tls_handshake) {
+    event.tls = 1;
+  }
+  if(!transfer.connects && !event.errors) {
+    event.reused = 1;
+  }
+
+  //the socket held before is replaced by a new one, or closed
+  if(open && (transfer.connects || !transfer.alive)) {
+    ctx_.conn_gauge_.close(raw_host);
+  }
+  if(transfer.connects) {
+    event.peak = ctx_.conn_gauge_.open(raw_host);
+    if(!transfer.alive) {
+      ctx_.conn_gauge_.close(raw_host);
+    }
+  }
+  open = transfer.alive;
+  return event;
+}
+
+// --------------
+// --- STREAM ---
+// --------------
+
+ryml::NodeRef scenario::request_out_node(ryml::NodeRef requests_out,
+                                         bool scratch)
+{
+  if(!scratch) {
+    return requests_out.append_child();
+  }
+  //the previous record is already emitted, its nodes and arena are reused
+  stream_tree_.clear();
+  stream_tree_.clear_arena();
+  ryml::NodeRef record = stream_tree_.rootref();
+  record |= ryml::MAP;
+  record[key_conversation] << stream_conv_idx_;
+  ryml::NodeRef request_out = record[key_request];
+  request_out |= ryml::MAP;
+  return request_out;
+}
+
+void scenario::stream_record(ryml::ConstNodeRef obj_out,
+                             bool is_request)
+{
+  //a scratch request is its record already
+  if(obj_out.tree() != &stream_tree_) {
+    stream_tree_.clear();
+    stream_tree_.clear_arena();
+    ryml::NodeRef record = stream_tree_.rootref();
+    record |= ryml::MAP;
+    record[key_conversation] << stream_conv_idx_;
+    ryml::NodeRef dest = is_request ? record[key_request] : record;
+    dest |= ryml::MAP;
+    utils::set_tree_node(*obj_out.tree(),
+                         obj_out,
+                         dest,
+                         ryml_stream_buf_);
+    //requests were emitted on their own
+    if(!is_request && record.has_child(key_requests)) {
+      record.remove_child(key_requests);
+    }
+  }
+
+  if(ctx_.cfg_.out_format == STR_YAML) {
+    *ctx_.output_ << YAML_DOC_SEP << std::endl << stream_tree_;
+  } else if(ctx_.cfg_.out_format == STR_JSON) {
+    *ctx_.output_ << ryml::as_json(stream_tree_) << std::endl;
+  } else if(binary_out_) {
+    write_binary(stream_tree_);
+  } else {
+    //ndjson lines are written by the context's writer thread only
+    return;
+  }
+  ctx_.output_->flush();
+}
+
+void scenario::write_binary(const ryml::Tree &t)
+{
+  binary_out_buf_.clear();
+  codec::encode(t, t.root_id(), *binary_out_, binary_out_buf_);
+  ctx_.output_->write(binary_out_buf_.data(), binary_out_buf_.size());
+}
+
+scenario::stream_scope::~stream_scope()
+{
+  if(parent_.streaming_) {
+    parent_.stream_record(obj_out_, true);
+  }
+}
+
 void scenario::enrich_with_stats(ryml::NodeRef scenario_out)
 {
   ryml::NodeRef statistics = scenario_out[key_stats];
@@ -614,9 +1158,10 @@ void scenario::enrich_with_stats(ryml::NodeRef scenario_out)
   ryml::NodeRef res_code_categorization = statistics[key_categorization];
   res_code_categorization |= ryml::MAP;
   std::for_each(stats_.categorization_.begin(), stats_.categorization_.end(), [&](const auto &it) {
-    ryml::csubstr code = res_code_categorization.to_arena(it.first);
+    ryml::csubstr code = res_code_categorization.to_arena(interner_.str(it.first));
     res_code_categorization[code] << it.second;
   });
+  utils::put_conn_stats(statistics, stats_.connections_);
 }
 
 }
@@ -1,12 +1,69 @@
 #pragma once
-#include "cbox.h"
+#include "plan.h"
+#include "expr.h"
 
-#define ERR_FAIL_EVAL "property evaluation failed"
-
-constexpr const char *PROP_EVAL_RGX = "\\{\\{.*?\\}\\}";
+#define ERR_FAIL_EVAL     "property evaluation failed"
+#define ERR_FAIL_CONVERT  "property conversion failed"
 
 namespace cbox {
 
+// ------------------------------
+// --- SCENARIO PROPERTY PATH ---
+// ------------------------------
+
+struct scenario_property_path {
+
+  enum root_kind {
+    //no token at all
+    empty,
+    //.key...
+    root,
+    //id.key...
+    id,
+    //.[conversation_idx][request_idx].key...
+    quick
+  };
+
+  enum step_kind {
+    by_key,
+    by_index,
+    //[-n], counting from the last child
+    by_rindex,
+    //[*]
+    all,
+    //[?field==value], [?field!=value]
+    filter_eq,
+    filter_ne,
+    bad_key,
+    bad_index
+  };
+
+  struct step {
+    step_kind kind;
+    //the key; for a filter, the value compared
+    std::string key;
+    size_t idx;
+    //for a filter, the path of the field relative to each child and its joined form
+    std::vector<std::string> field;
+    std::string field_key;
+  };
+
+  void compile(const std::string &path);
+
+  //compiles the content of a [*], [-n] or [?...] subscript
+  bool compile_query(std::string_view subscript);
+
+  root_kind root_ = empty;
+  std::string id_;
+  //id_ interned, once the id is known
+  mutable std::optional<utils::interner::handle> id_handle_;
+  size_t conv_idx_ = 0, req_idx_ = 0;
+  std::vector<step> steps_;
+
+  //the path has [*] or [?...] steps, so it can select many nodes
+  bool query_ = false;
+};
+
 // ----------------------------------
 // --- SCENARIO PROPERTY RESOLVER ---
 // ----------------------------------
@@ -20,17 +77,96 @@ struct scenario_property_resolver {
 
   std::optional<ryml::ConstNodeRef> resolve(const std::string &path) const;
 
-  std::optional<ryml::ConstNodeRef> resolve_common(ryml::ConstNodeRef from, utils::str_tok &tknz) const;
+  //a requests sequence was cleared: the ids of its children may be recycled
+  void requests_cleared() {
+    ++generation_;
+  }
+
+  std::optional<ryml::ConstNodeRef> resolve(const scenario_property_path &cpath) const;
+
+  //appends the scalar a path resolves to, or the scalars a query selects joined by ','
+  bool render(const std::string &path,
+              std::string &out) const;
+
+  const scenario_property_path &get_path(const std::string &path) const;
+
+  std::optional<ryml::ConstNodeRef> resolve_root(const scenario_property_path &cpath) const;
+
+  std::optional<ryml::ConstNodeRef> resolve_common(ryml::ConstNodeRef from,
+                                                   const scenario_property_path &cpath) const;
+
+  void resolve_query(ryml::ConstNodeRef from,
+                     const scenario_property_path &cpath,
+                     size_t step_idx,
+                     std::vector<ryml::ConstNodeRef> &out) const;
+
+  void filter(ryml::ConstNodeRef seq,
+              const scenario_property_path::step &stp,
+              std::vector<ryml::ConstNodeRef> &out) const;
+
+  // -------------------
+  // --- FIELD INDEX ---
+  // -------------------
+
+  //child ids of a requests sequence by the value of a field, built lazily;
+  //appended children extend the index, a cleared sequence invalidates it by generation;
+  //all children but the last are indexed, the last one may still be in progress
+  struct field_index {
+    uint64_t generation = 0;
+    size_t last_id = ryml::NONE;
+    size_t indexed = 0;
+    std::unordered_map<std::string, std::vector<size_t>> ids;
+  };
 
   //parent
   scenario &parent_;
 
   ryml::ConstNodeRef scenario_obj_root_;
 
+  //compiled paths, by path
+  mutable std::unordered_map<std::string, scenario_property_path> paths_;
+
+  //filter indexes by tree, sequence node id and field
+  mutable std::unordered_map<const ryml::Tree *,
+          std::unordered_map<size_t, std::unordered_map<std::string, field_index>>> indexes_;
+
+  //bumped whenever a requests sequence is cleared
+  uint64_t generation_ = 0;
+
   //event logger
   std::shared_ptr<spdlog::logger> event_log_;
 };
 
+// ----------------------------------
+// --- SCENARIO PROPERTY TEMPLATE ---
+// ----------------------------------
+
+struct scenario_property_template {
+
+  enum segment_kind {
+    //literal text
+    text,
+    //a {{path}} placeholder
+    path,
+    //a {{= expression}} placeholder
+    expr,
+    //a {{= expression}} that failed to compile, text holds the error
+    bad_expr
+  };
+
+  struct segment {
+    segment_kind kind;
+    std::string text;
+    expression expr;
+  };
+
+  void compile(ryml::csubstr source);
+
+  //the text compiled from, a cached template is valid only while it matches
+  std::string source_;
+  std::vector<segment> segments_;
+};
+
 // -----------------------------------
 // --- SCENARIO PROPERTY EVALUATOR ---
 // -----------------------------------
@@ -42,44 +178,107 @@ struct scenario_property_evaluator {
   int init(std::shared_ptr<spdlog::logger> &event_log);
   int reset(ryml::ConstNodeRef scenario_obj_root);
 
+  const scenario_property_template &get_template(ryml::ConstNodeRef n_val);
+
+  //single pass render into render_buf_
+  bool render(const scenario_property_template &tpl,
+              const scenario_property_resolver &spr);
+
+  //evaluates an expression segment into expr_val_
+  bool eval_expr(const scenario_property_template::segment &seg,
+                 const scenario_property_resolver &spr);
+
+  //a typed expression result converted to T, nullopt when it does not fit
+  template <typename T>
+  std::optional<T> expr_as() const {
+    if constexpr(std::is_same_v<T, bool>) {
+      if(expr_val_.kind_ == expression::value::boolean) {
+        return expr_val_.num_ != 0;
+      }
+    } else if constexpr(std::is_arithmetic_v<T>) {
+      double num = expr_val_.num_;
+      if(expr_val_.kind_ == expression::value::number &&
+          (std::is_floating_point_v<T> ||
+           (num == std::trunc(num) &&
+            num >= (double)std::numeric_limits<T>::min() &&
+            num <= (double)std::numeric_limits<T>::max()))) {
+        return (T)num;
+      }
+    }
+    return utils::converter<T>::parse(expr_val_.as_string());
+  }
+
   template <typename T>
   std::optional<T> eval_as(ryml::ConstNodeRef from,
                            const char *key,
                            const scenario_property_resolver &spr) {
     ryml::ConstNodeRef n_val = from[ryml::to_csubstr(key)];
-    std::string str_val, str_res;
-    n_val >> str_val;
-    str_res = str_val;
-    std::regex rgx(PROP_EVAL_RGX);
-
-    std::regex_iterator<std::string::const_iterator> rit(str_val.cbegin(), str_val.cend(), rgx);
-    std::regex_iterator<std::string::const_iterator> rend;
-
-    while(rit!=rend) {
-      auto node_ref = spr.resolve(utils::trim(utils::find_and_replace(utils::find_and_replace(rit->str(),
-                                                                                              "{{", ""), "}}", "")));
-      if(node_ref && ((*node_ref).is_keyval() || (*node_ref).is_val())) {
-        auto node_val = utils::converter<std::string>::asType(*node_ref);
-        str_res = std::regex_replace(str_res,rgx,node_val,std::regex_constants::format_first_only);
-      } else {
-        return std::nullopt;
+    const scenario_property_template &tpl = get_template(n_val);
+
+    //a whole-field reference converts the typed scalar, with no string round trip
+    if constexpr(!std::is_same_v<T, std::string>) {
+      if(tpl.segments_.size() == 1) {
+        const auto &seg = tpl.segments_[0];
+        std::optional<T> res;
+        if(seg.kind == scenario_property_template::path) {
+          const scenario_property_path &cpath = spr.get_path(seg.text);
+          if(!cpath.query_) {
+            auto node_ref = spr.resolve(cpath);
+            if(!node_ref || !((*node_ref).is_keyval() || (*node_ref).is_val())) {
+              return std::nullopt;
+            }
+            ryml::csubstr val = (*node_ref).val();
+            res = utils::converter<T>::parse(std::string_view(val.str, val.len));
+            if(!res) {
+              event_log_->error("{}:'{}' is not {}", ERR_FAIL_CONVERT, std::string(val.str, val.len), utils::converter<T>::name());
+            }
+            return res;
+          }
+        } else if(seg.kind == scenario_property_template::expr) {
+          if(!eval_expr(seg, spr)) {
+            return std::nullopt;
+          }
+          res = expr_as<T>();
+          if(!res) {
+            event_log_->error("{}:'{}' is not {}", ERR_FAIL_CONVERT, expr_val_.as_string(), utils::converter<T>::name());
+          }
+          return res;
+        }
       }
-      ++rit;
+    }
+
+    if(!render(tpl, spr)) {
+      return std::nullopt;
     }
 
     if constexpr(std::is_same_v<T, std::string>) {
-      return str_res;
+      return render_buf_;
     } else {
-      T res;
-      std::stringstream ss;
-      ss << str_res;
-      ss >> res;
+      auto res = utils::converter<T>::parse(render_buf_);
+      if(!res) {
+        event_log_->error("{}:'{}' is not {}", ERR_FAIL_CONVERT, render_buf_, utils::converter<T>::name());
+      }
       return res;
     }
   }
 
   ryml::ConstNodeRef scenario_obj_root_;
 
+  //compiled templates by tree and node id
+  std::unordered_map<const ryml::Tree *, std::unordered_map<size_t, scenario_property_template>> templates_;
+
+  //render buffer, reused across evaluations
+  std::string render_buf_;
+
+  //the index of the current iteration of a request's 'for', seen by expressions as i
+  uint32_t iteration_ = 0;
+
+  //rand() generator
+  std::mt19937_64 rng_{std::random_device{}()};
+
+  //expression result, reused across evaluations
+  expression::value expr_val_;
+
   //event logger
   std::shared_ptr<spdlog::logger> event_log_;
 };
@@ -92,34 +291,21 @@ struct scenario {
 
     struct stack_scope {
 
-// *INDENT-OFF*
-        stack_scope(scenario &parent,
-                    ryml::NodeRef obj_in,
-                    ryml::NodeRef obj_out,
-                    bool &error,
-                    const ryml::Tree &default_out_options = utils::get_default_out_options(),
-                    bool call_dump_val_cb = false,
-                    const std::function<void(const std::string &key, bool val)> &dump_val_cb =
-                    [](const std::string &, bool) {},
-                    bool call_format_val_cb = false,
-                    const std::function<void(const std::string &key, const std::string &val)> &format_val_cb =
-                    [](const std::string &, const std::string &) {});
-// *INDENT-ON*
+      stack_scope(scenario &parent,
+                  ryml::NodeRef obj_in,
+                  ryml::NodeRef obj_out,
+                  bool &error,
+                  const utils::out_options &default_out_options = utils::get_default_out_options());
 
       ~stack_scope();
 
-// *INDENT-OFF*
-      bool push_out_opts(const ryml::Tree &default_out_options,
-                         bool call_dump_val_cb = false,
-                         const std::function<void(const std::string &key, bool val)> &dump_val_cb =
-                         [](const std::string &, bool) {},
-                         bool call_format_val_cb = false,
-                         const std::function<void(const std::string &key, const std::string &val)> &format_val_cb =
-                         [](const std::string &, const std::string &) {});
-// *INDENT-ON*
+      bool push_out_opts(const utils::out_options &default_out_options);
 
       bool pop_process_out_opts();
 
+      //whether key survives in the rendered output
+      bool dumps(utils::out_options::dump_key key) const;
+
       void commit() {
         commit_ = true;
       }
@@ -127,32 +313,67 @@ struct scenario {
       scenario &parent_;
       ryml::NodeRef obj_in_;
       ryml::NodeRef obj_out_;
-      ryml::Tree out_opts_;
+
+      //the options in effect: the defaults, a cached resolution or own_out_opts_
+      const utils::out_options *out_opts_ = nullptr;
+
+      //the options of an out node that may differ from its input's
+      utils::out_options own_out_opts_;
 
       bool &error_;
       bool enabled_, commit_;
     };
 
+    // --------------------
+    // --- STREAM SCOPE ---
+    // --------------------
+
+    //emits a finished request as a record when it goes out of scope;
+    //declared before the request's stack_scope, it sees the node once committed
+    struct stream_scope {
+
+      stream_scope(scenario &parent,
+                   ryml::NodeRef obj_out) : parent_(parent), obj_out_(obj_out) {}
+
+      ~stream_scope();
+
+      scenario &parent_;
+      ryml::NodeRef obj_out_;
+    };
+
     // ------------------
     // --- STATISTICS ---
     // ------------------
 
     struct statistics {
         friend struct scenario;
+        friend struct search;
 
         statistics(scenario &parent) : parent_(parent) {}
 
         void reset();
         void incr_conversation_count();
         void incr_request_count();
-        void incr_categorization(const std::string &key);
+        void incr_categorization(utils::interner::handle key);
+        void record_response(int32_t code, int64_t rtt);
+        void record_connection(const std::string &host, const utils::conn_stats &event);
+        void merge(const statistics &other);
 
         scenario &parent_;
 
       private:
         uint32_t conversation_count_ = 0;
         uint32_t request_count_ = 0;
-        std::unordered_map<std::string, int32_t> categorization_;
+        std::unordered_map<utils::interner::handle, int32_t> categorization_;
+
+        //responses failed at transport level or with a 5xx code
+        uint32_t error_count_ = 0;
+
+        //response round trip times in nanoseconds
+        utils::histogram rtt_hist_;
+
+        //connection counters per host
+        std::unordered_map<std::string, utils::conn_stats> connections_;
     };
 
     scenario(context &env);
@@ -176,6 +397,28 @@ struct scenario {
 
     void enrich_with_stats(ryml::NodeRef scenario_out);
 
+    utils::http_connection &get_connection(const std::string &raw_host);
+
+    //counts a request on its connection, from what curl reported of the transfer
+    utils::conn_stats track_connection(const std::string &raw_host,
+                                       const RestClient::Response &resRC,
+                                       const utils::transfer_info &transfer);
+
+    // --------------
+    // --- Stream ---
+    // --------------
+
+    //the node a request is written into: the scratch record when nothing can read
+    //the request back once emitted, a new child of requests_out otherwise
+    ryml::NodeRef request_out_node(ryml::NodeRef requests_out,
+                                   bool scratch);
+
+    //emits a finished request or conversation as a record of its own
+    void stream_record(ryml::ConstNodeRef obj_out,
+                       bool is_request);
+
+    void write_binary(const ryml::Tree &t);
+
   public:
     context &ctx_;
 
@@ -186,8 +429,29 @@ struct scenario {
     //ryml scenario out support buffer
     std::vector<char> ryml_scenario_out_buf_;
 
-    //map holding nodes with an explicit id set
-    std::unordered_map<std::string, ryml::ConstNodeRef> indexed_nodes_map_;
+    //streaming: finished requests and conversations are emitted as records
+    bool streaming_ = false;
+
+    //streaming with no positional references nor handlers,
+    //requests that cannot be read back are not kept in scenario_out_
+    bool prunable_ = false;
+
+    //the index of the conversation being streamed
+    uint32_t stream_conv_idx_ = 0;
+
+    //the record being emitted, cleared and reused for each one
+    ryml::Tree stream_tree_;
+    std::vector<char> ryml_stream_buf_;
+
+    //cbor or msgpack output, encoded into a reused buffer
+    std::optional<codec::format> binary_out_;
+    std::string binary_out_buf_;
+
+    //ids and category keys
+    utils::interner interner_;
+
+    //map holding nodes with an explicit id set, by interned id
+    std::unordered_map<utils::interner::handle, ryml::ConstNodeRef> indexed_nodes_map_;
 
     //scenario property resolver
     scenario_property_resolver scen_out_p_resolv_;
@@ -198,9 +462,25 @@ struct scenario {
     //scenario statistics
     statistics stats_;
 
+    //request plans compiled from the scenario-in
+    scenario_plan plan_;
+
+    //out options resolved once per scenario-in node with a static out, by node id
+    std::unordered_map<size_t, utils::out_options> out_opts_cache_;
+
     //js environment
     js::js_env js_env_;
 
+    //connections are kept across requests with -k or more than one worker,
+    //otherwise every request gets a fresh one
+    bool pooled_ = false;
+
+    //connection pool, one connection per host
+    std::unordered_map<std::string, std::unique_ptr<utils::http_connection>> connections_;
+
+    //whether the socket of a connection is open, as curl reported after its last transfer
+    std::unordered_map<std::string, bool> conn_open_;
+
   private:
     //assert failure
     bool assert_failure_ = false;
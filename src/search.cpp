@@ -0,0 +1,190 @@
+#include "search.h"
+
+#define ERR_FAIL_RESET_SEARCH   "failed to reset search"
+#define ERR_FAIL_READ_SEARCH    "failed to read 'search'"
+#define ERR_BAD_SEARCH_BOUNDS   "bad 'search' bounds"
+#define ERR_FAIL_SEARCH_STEP    "failed to run search step"
+
+namespace cbox {
+
+search::search(scenario &parent) :
+  parent_(parent),
+  js_env_(parent.js_env_),
+  event_log_(parent.event_log_)
+{}
+
+int search::reset()
+{
+  min_ = max_ = 1;
+  rounds_ = 10;
+  slo_p99_.reset();
+  slo_errors_ = 0;
+  return 0;
+}
+
+int search::process(uint32_t conv_idx,
+                    ryml::NodeRef conversation_in,
+                    ryml::NodeRef conversation_out)
+{
+  int res = 0;
+  ryml::NodeRef search_out = conversation_out[key_search];
+
+  if((res = reset())) {
+    event_log_->error(ERR_FAIL_RESET_SEARCH);
+    return res;
+  }
+
+  auto enabled = js_env_.eval_as<bool>(conversation_in, key_enabled, true);
+  if(enabled && !*enabled) {
+    utils::clear_map_node_put_key_val(conversation_out, key_enabled, STR_FALSE);
+    return 0;
+  }
+
+  // bounds, rounds and slo
+  auto min = js_env_.eval_as<uint32_t>(search_out, key_min, 1);
+  auto max = js_env_.eval_as<uint32_t>(search_out, key_max, executor::concurrency(0));
+  auto rounds = js_env_.eval_as<uint32_t>(search_out, key_rounds, 10);
+  if(!min || !max || !rounds) {
+    event_log_->error(ERR_FAIL_READ_SEARCH);
+    utils::clear_map_node_put_key_val(conversation_out, key_error, ERR_FAIL_READ_SEARCH);
+    return 1;
+  }
+  if(!*min || *min > *max || *min > max_concurrency || !*rounds) {
+    event_log_->error("{}:[{},{}]", ERR_BAD_SEARCH_BOUNDS, *min, *max);
+    utils::clear_map_node_put_key_val(conversation_out, key_error, ERR_BAD_SEARCH_BOUNDS);
+    return 1;
+  }
+  if(*max > max_concurrency) {
+    event_log_->warn("search max {} clamped to {}", *max, max_concurrency);
+    *max = max_concurrency;
+  }
+  min_ = *min;
+  max_ = *max;
+  rounds_ = *rounds;
+
+  if(search_out.has_child(key_slo)) {
+    ryml::NodeRef slo = search_out[key_slo];
+    slo_p99_ = js_env_.eval_as<double>(slo, key_p99);
+    auto errors = js_env_.eval_as<double>(slo, key_errors, 0.0);
+    if(!errors) {
+      event_log_->error(ERR_FAIL_READ_SEARCH);
+      utils::clear_map_node_put_key_val(conversation_out, key_error, ERR_FAIL_READ_SEARCH);
+      return 1;
+    }
+    slo_errors_ = *errors;
+  }
+
+  ryml::NodeRef steps_out = search_out[key_steps];
+  steps_out |= ryml::SEQ;
+  steps_out.clear_children();
+
+  // ramp up doubling the concurrency, then bisect between the last pass and the first failure
+  uint64_t lo = 0, hi = uint64_t(max_) + 1;
+  for(uint32_t concurrency = min_;;) {
+    step stp;
+    if((res = run_step(conv_idx, concurrency, stp))) {
+      break;
+    }
+    render_step(stp, steps_out);
+    if(!stp.pass) {
+      hi = concurrency;
+      break;
+    }
+    lo = concurrency;
+    if(concurrency == max_) {
+      break;
+    }
+    concurrency = uint32_t(std::min<uint64_t>(max_, uint64_t(concurrency) * 2));
+  }
+
+  while(!res && lo && hi - lo > 1) {
+    step stp;
+    uint32_t concurrency = uint32_t(lo + (hi - lo) / 2);
+    if((res = run_step(conv_idx, concurrency, stp))) {
+      break;
+    }
+    render_step(stp, steps_out);
+    if(stp.pass) {
+      lo = concurrency;
+    } else {
+      hi = concurrency;
+    }
+  }
+
+  if(res) {
+    event_log_->error(ERR_FAIL_SEARCH_STEP);
+    utils::clear_map_node_put_key_val(conversation_out, key_error, ERR_FAIL_SEARCH_STEP);
+    return res;
+  }
+
+  //0 when not even the lower bound meets the slo
+  if(search_out.has_child(key_best)) {
+    search_out.remove_child(key_best);
+  }
+  search_out[key_best] << lo;
+  return 0;
+}
+
+int search::run_step(uint32_t conv_idx,
+                     uint32_t concurrency,
+                     step &stp)
+{
+  executor exec(parent_);
+  scenario::statistics step_stats(parent_);
+  std::mutex step_mtx;
+  std::optional<std::chrono::steady_clock::time_point> t0, t1;
+
+  event_log_->debug("search step at concurrency {}", concurrency);
+
+  int res = exec.run(concurrency, [&](executor::worker &w) -> int {
+    int res = 0;
+    ryml::NodeRef conversation_in = w.doc_in_.rootref()[key_conversations][conv_idx];
+    ryml::NodeRef conversation_out = w.shard_->scenario_out_.rootref()[key_conversations][conv_idx];
+
+    //the shards are released together: the step spans from the first start to the last end
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for(uint32_t round = 0; round < rounds_; ++round) {
+      conversation conv(*w.shard_);
+
+      if((res = conv.process(conversation_in,
+                             conversation_out))) {
+        break;
+      }
+    }
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+    std::lock_guard<std::mutex> lock(step_mtx);
+    t0 = t0 ? std::min(*t0, start) : start;
+    t1 = t1 ? std::max(*t1, end) : end;
+    step_stats.merge(w.shard_->stats_);
+    return res;
+  });
+
+  std::chrono::duration<double> elapsed = t0 ? *t1 - *t0 : std::chrono::duration<double>::zero();
+
+  stp.concurrency = concurrency;
+  stp.requests = step_stats.rtt_hist_.count_;
+  stp.throughput = elapsed.count() > 0 ? stp.requests / elapsed.count() : 0;
+  stp.p99 = step_stats.rtt_hist_.quantile(0.99) / 1000000.0;
+  stp.errors = stp.requests ? step_stats.error_count_ * 100.0 / stp.requests : 0;
+  stp.pass = !res &&
+             stp.requests &&
+             (!slo_p99_ || stp.p99 <= *slo_p99_) &&
+             stp.errors <= slo_errors_;
+  return res;
+}
+
+void search::render_step(const step &stp,
+                         ryml::NodeRef steps_out)
+{
+  ryml::NodeRef step_out = steps_out.append_child();
+  step_out |= ryml::MAP;
+  step_out[key_concurrency] << stp.concurrency;
+  step_out[key_requests] << stp.requests;
+  step_out[key_throughput] << fmt::format("{:.2f}", stp.throughput);
+  step_out[key_p99] << fmt::format("{:.3f}", stp.p99);
+  step_out[key_errors] << fmt::format("{:.2f}", stp.errors);
+  step_out[key_pass] << (stp.pass ? STR_TRUE : STR_FALSE);
+}
+
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include "executor.h"
+
+namespace cbox {
+
+struct search {
+
+    // ------------
+    // --- STEP ---
+    // ------------
+
+    struct step {
+      uint32_t concurrency = 0;
+      uint64_t requests = 0;
+      double throughput = 0;
+      double p99 = 0;
+      double errors = 0;
+      bool pass = false;
+    };
+
+    //every concurrent worker owns a thread, a V8 isolate and a copy of the input:
+    //higher 'max' bounds are clamped to this
+    static constexpr uint32_t max_concurrency = 256;
+
+    search(scenario &parent);
+
+    int reset();
+
+    int process(uint32_t conv_idx,
+                ryml::NodeRef conversation_in,
+                ryml::NodeRef conversation_out);
+
+  private:
+
+    int run_step(uint32_t conv_idx,
+                 uint32_t concurrency,
+                 step &stp);
+
+    void render_step(const step &stp,
+                     ryml::NodeRef steps_out);
+
+    // -----------
+    // --- REP ---
+    // -----------
+
+    //parent
+    scenario &parent_;
+
+    //js environment
+    js::js_env &js_env_;
+
+    //event logger
+    std::shared_ptr<spdlog::logger> event_log_;
+
+    //concurrency bounds
+    uint32_t min_ = 1, max_ = 1;
+
+    //conversation runs per worker at each step
+    uint32_t rounds_ = 10;
+
+    //slo: p99 latency in milliseconds, error ratio in percent
+    std::optional<double> slo_p99_;
+    double slo_errors_ = 0;
+};
+
+}
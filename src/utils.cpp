@@ -1,72 +1,146 @@
+#include <zlib.h>
+#include <zstd.h>
 #include "utils.h"
 #include "crypto.h"
 
 const std::string algorithm = "AWS4-HMAC-SHA256";
 namespace utils {
 
-static std::unique_ptr<ryml::Tree> default_out_options;
-const ryml::Tree &get_default_out_options()
+// -------------------
+// --- OUT OPTIONS ---
+// -------------------
+
+std::optional<out_options::dump_key> out_options::dump_key_of(std::string_view key)
+{
+  //in dump_key order
+  static const char *const names[] = {key_out, key_query_string, key_data, key_auth};
+  for(size_t it = 0; it < sizeof(names) / sizeof(names[0]); ++it) {
+    if(key == names[it]) {
+      return (dump_key)it;
+    }
+  }
+  return std::nullopt;
+}
+
+void out_options::set_dump(std::string_view key, bool val)
+{
+  if(auto dk = dump_key_of(key)) {
+    if(val) {
+      hidden_ &= ~(1u << *dk);
+    } else {
+      hidden_ |= 1u << *dk;
+    }
+  }
+  for(auto &it : dump_) {
+    if(it.first == key) {
+      it.second = val;
+      return;
+    }
+  }
+  dump_.emplace_back(key, val);
+}
+
+void out_options::set_format(std::string_view key, std::string_view val)
+{
+  if(key == key_rtt) {
+    rtt_ = from_literal(std::string(val));
+  } else if(key == key_body) {
+    body_ = val == STR_JSON ? body_json : val == STR_XML ? body_xml : body_string;
+  }
+  for(auto &it : format_) {
+    if(it.first == key) {
+      it.second = val;
+      return;
+    }
+  }
+  format_.emplace_back(key, val);
+}
+
+void out_options::merge(ryml::ConstNodeRef out_node)
+{
+  if(out_node.has_child(key_dump)) {
+    for(ryml::ConstNodeRef const &dn_c : out_node[key_dump].children()) {
+      set_dump(std::string_view(dn_c.key().str, dn_c.key().len), dn_c.val() != STR_FALSE);
+    }
+  }
+  if(out_node.has_child(key_format)) {
+    for(ryml::ConstNodeRef const &fn_c : out_node[key_format].children()) {
+      set_format(std::string_view(fn_c.key().str, fn_c.key().len),
+                 std::string_view(fn_c.val().str, fn_c.val().len));
+    }
+  }
+}
+
+void out_options::render(ryml::NodeRef out_node) const
+{
+  out_node |= ryml::MAP;
+  if(out_node.has_child(key_dump)) {
+    out_node.remove_child(key_dump);
+  }
+  ryml::NodeRef dump = out_node[key_dump];
+  dump |= ryml::MAP;
+  for(const auto &it : dump_) {
+    dump[dump.to_arena(it.first)] << (it.second ? STR_TRUE : STR_FALSE);
+  }
+  if(out_node.has_child(key_format)) {
+    out_node.remove_child(key_format);
+  }
+  ryml::NodeRef format = out_node[key_format];
+  format |= ryml::MAP;
+  for(const auto &it : format_) {
+    format[format.to_arena(it.first)] << it.second;
+  }
+}
+
+static std::unique_ptr<out_options> default_out_options;
+const out_options &get_default_out_options()
 {
   if(!default_out_options) {
-    default_out_options.reset(new ryml::Tree);
-    ryml::NodeRef root = default_out_options->rootref();
-    root |= ryml::MAP;
-    ryml::NodeRef default_out_dumps = root[key_dump];
-    default_out_dumps |= ryml::MAP;
-    default_out_dumps[key_out] << STR_FALSE;
-    default_out_dumps[key_before] << STR_FALSE;
-    default_out_dumps[key_after] << STR_FALSE;
-    default_out_dumps[key_enabled] << STR_FALSE;
-    ryml::NodeRef default_out_formats = root[key_format];
-    default_out_formats |= ryml::MAP;
-    default_out_formats[key_rtt] << key_msec;
+    default_out_options.reset(new out_options);
+    default_out_options->set_dump(key_out, false);
+    default_out_options->set_dump(key_before, false);
+    default_out_options->set_dump(key_after, false);
+    default_out_options->set_dump(key_enabled, false);
+    default_out_options->set_format(key_rtt, key_msec);
   }
   return *default_out_options;
 }
 
-static std::unique_ptr<ryml::Tree> default_scenario_out_options;
-const ryml::Tree &get_default_scenario_out_options()
+static std::unique_ptr<out_options> default_scenario_out_options;
+const out_options &get_default_scenario_out_options()
 {
   if(!default_scenario_out_options) {
-    default_scenario_out_options.reset(new ryml::Tree);
-    *default_scenario_out_options = get_default_out_options();
+    default_scenario_out_options.reset(new out_options(get_default_out_options()));
   }
   return *default_scenario_out_options;
 }
 
-static std::unique_ptr<ryml::Tree> default_conversation_out_options;
-const ryml::Tree &get_default_conversation_out_options()
+static std::unique_ptr<out_options> default_conversation_out_options;
+const out_options &get_default_conversation_out_options()
 {
   if(!default_conversation_out_options) {
-    default_conversation_out_options.reset(new ryml::Tree);
-    *default_conversation_out_options = get_default_out_options();
+    default_conversation_out_options.reset(new out_options(get_default_out_options()));
   }
   return *default_conversation_out_options;
 }
 
-static std::unique_ptr<ryml::Tree> default_request_out_options;
-const ryml::Tree &get_default_request_out_options()
+static std::unique_ptr<out_options> default_request_out_options;
+const out_options &get_default_request_out_options()
 {
   if(!default_request_out_options) {
-    default_request_out_options.reset(new ryml::Tree);
-    *default_request_out_options = get_default_out_options();
-    ryml::NodeRef root = default_request_out_options->rootref();
-    ryml::NodeRef request_out_dumps = root[key_dump];
-    request_out_dumps[key_for] << STR_FALSE;
-    request_out_dumps[key_mock] << STR_FALSE;
+    default_request_out_options.reset(new out_options(get_default_out_options()));
+    default_request_out_options->set_dump(key_for, false);
+    default_request_out_options->set_dump(key_mock, false);
   }
   return *default_request_out_options;
 }
 
-static std::unique_ptr<ryml::Tree> default_response_out_options;
-const ryml::Tree &get_default_response_out_options()
+static std::unique_ptr<out_options> default_response_out_options;
+const out_options &get_default_response_out_options()
 {
   if(!default_response_out_options) {
-    default_response_out_options.reset(new ryml::Tree);
-    *default_response_out_options = get_default_out_options();
-    ryml::NodeRef root = default_response_out_options->rootref();
-    ryml::NodeRef response_out_formats = root[key_format];
-    response_out_formats[key_body] << STR_JSON;
+    default_response_out_options.reset(new out_options(get_default_out_options()));
+    default_response_out_options->set_format(key_body, STR_JSON);
   }
   return *default_response_out_options;
 }
@@ -95,6 +169,519 @@ size_t file_get_contents(const char *filename,
   return v.size();
 }
 
+// -------------------
+// --- LINE WRITER ---
+// -------------------
+
+void line_writer::start(std::ostream &out)
+{
+  out_ = &out;
+  stop_ = false;
+  thread_ = std::thread(&line_writer::run, this);
+}
+
+void line_writer::write(std::string &&line)
+{
+  {
+    std::unique_lock<std::mutex> lock(mtx_);
+    cv_.wait(lock, [&] { return queue_.size() < max_pending; });
+    queue_.emplace_back(std::move(line));
+  }
+  cv_.notify_all();
+}
+
+void line_writer::stop()
+{
+  if(!thread_.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  thread_.join();
+}
+
+void line_writer::run()
+{
+  std::vector<std::string> batch;
+  for(;;) {
+    bool stop;
+    {
+      std::unique_lock<std::mutex> lock(mtx_);
+      cv_.wait(lock, [&] { return stop_ || !queue_.empty(); });
+      //the writer takes the whole queue, callers keep pushing meanwhile
+      batch.swap(queue_);
+      stop = stop_;
+    }
+    cv_.notify_all();
+    for(const std::string &line : batch) {
+      *out_ << line << '\n';
+    }
+    batch.clear();
+    out_->flush();
+    if(stop) {
+      std::lock_guard<std::mutex> lock(mtx_);
+      if(queue_.empty()) {
+        return;
+      }
+    }
+  }
+}
+
+void append_json_string(std::string &out, std::string_view str)
+{
+  out += '"';
+  for(char c : str) {
+    switch(c) {
+      case '"':
+        out += "\\\"";
+        break;
+      case '\\':
+        out += "\\\\";
+        break;
+      case '\n':
+        out += "\\n";
+        break;
+      case '\r':
+        out += "\\r";
+        break;
+      case '\t':
+        out += "\\t";
+        break;
+      default:
+        if((unsigned char)c < 0x20) {
+          fmt::format_to(std::back_inserter(out), "\\u{:04x}", (unsigned)c);
+        } else {
+          out += c;
+        }
+    }
+  }
+  out += '"';
+}
+
+// -----------------------
+// --- HTTP CONNECTION ---
+// -----------------------
+
+static size_t on_body(char *data, size_t size, size_t nmemb, void *userdata)
+{
+  static_cast<RestClient::Response *>(userdata)->body.append(data, size * nmemb);
+  return size * nmemb;
+}
+
+static size_t on_header(char *data, size_t size, size_t nmemb, void *userdata)
+{
+  RestClient::Response *resRC = static_cast<RestClient::Response *>(userdata);
+  std::string header(data, size * nmemb);
+  size_t sep = header.find(':');
+  if(sep == std::string::npos) {
+    //lines without a separator, like the status line, are kept as restclient-cpp does
+    trim(header);
+    if(!header.empty()) {
+      resRC->headers[header] = "present";
+    }
+  } else {
+    std::string key = header.substr(0, sep);
+    std::string value = header.substr(sep + 1);
+    trim(key);
+    trim(value);
+    resRC->headers[key] = value;
+  }
+  return size * nmemb;
+}
+
+//the request body is read by curl, so that a throttled upload is paced as it is sent
+struct upload_source {
+  const std::string *data;
+  size_t offset;
+};
+
+static size_t on_upload(char *buf, size_t size, size_t nitems, void *userdata)
+{
+  upload_source *src = static_cast<upload_source *>(userdata);
+  size_t len = std::min(size * nitems, src->data->size() - src->offset);
+  std::memcpy(buf, src->data->data() + src->offset, len);
+  src->offset += len;
+  return len;
+}
+
+http_connection::http_connection(const std::string &base_url) :
+  curl_(curl_easy_init()),
+  base_url_(base_url) {}
+
+http_connection::~http_connection()
+{
+  if(curl_) {
+    curl_easy_cleanup(curl_);
+  }
+}
+
+RestClient::Response http_connection::get(const std::string &uri)
+{
+  return perform(http_get, uri, nullptr);
+}
+
+RestClient::Response http_connection::post(const std::string &uri, const std::string &data)
+{
+  return perform(http_post, uri, &data);
+}
+
+RestClient::Response http_connection::put(const std::string &uri, const std::string &data)
+{
+  return perform(http_put, uri, &data);
+}
+
+RestClient::Response http_connection::del(const std::string &uri)
+{
+  return perform(http_delete, uri, nullptr);
+}
+
+RestClient::Response http_connection::head(const std::string &uri)
+{
+  return perform(http_head, uri, nullptr);
+}
+
+RestClient::Response http_connection::perform(http_method method,
+                                              const std::string &uri,
+                                              const std::string *data)
+{
+  RestClient::Response resRC;
+  info_ = transfer_info();
+  if(!curl_) {
+    resRC.code = CURLE_FAILED_INIT;
+    resRC.body = "Failed to query.";
+    return resRC;
+  }
+
+  //a reset handle keeps its open connections
+  curl_easy_reset(curl_);
+
+  std::string url = base_url_ + uri;
+  curl_easy_setopt(curl_, CURLOPT_URL, url.c_str());
+  curl_easy_setopt(curl_, CURLOPT_NOSIGNAL, 1L);
+  curl_easy_setopt(curl_, CURLOPT_TIMEOUT, 30L);
+  curl_easy_setopt(curl_, CURLOPT_SSL_VERIFYPEER, 0L);
+  curl_easy_setopt(curl_, CURLOPT_SSL_VERIFYHOST, 0L);
+  curl_easy_setopt(curl_, CURLOPT_WRITEFUNCTION, on_body);
+  curl_easy_setopt(curl_, CURLOPT_WRITEDATA, &resRC);
+  curl_easy_setopt(curl_, CURLOPT_HEADERFUNCTION, on_header);
+  curl_easy_setopt(curl_, CURLOPT_HEADERDATA, &resRC);
+
+  curl_slist *hlist = nullptr;
+  for(const auto &it : headers_) {
+    std::string header = it.first + ": " + it.second;
+    hlist = curl_slist_append(hlist, header.c_str());
+  }
+  curl_easy_setopt(curl_, CURLOPT_HTTPHEADER, hlist);
+
+  upload_source src{data, 0};
+  switch(method) {
+    case http_post:
+      curl_easy_setopt(curl_, CURLOPT_POST, 1L);
+      curl_easy_setopt(curl_, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)data->size());
+      curl_easy_setopt(curl_, CURLOPT_READFUNCTION, on_upload);
+      curl_easy_setopt(curl_, CURLOPT_READDATA, &src);
+      break;
+    case http_put:
+      curl_easy_setopt(curl_, CURLOPT_UPLOAD, 1L);
+      curl_easy_setopt(curl_, CURLOPT_INFILESIZE_LARGE, (curl_off_t)data->size());
+      curl_easy_setopt(curl_, CURLOPT_READFUNCTION, on_upload);
+      curl_easy_setopt(curl_, CURLOPT_READDATA, &src);
+      break;
+    case http_delete:
+      curl_easy_setopt(curl_, CURLOPT_CUSTOMREQUEST, HTTP_DELETE);
+      break;
+    case http_head:
+      curl_easy_setopt(curl_, CURLOPT_CUSTOMREQUEST, HTTP_HEAD);
+      curl_easy_setopt(curl_, CURLOPT_NOBODY, 1L);
+      break;
+    default:
+      break;
+  }
+
+  //curl holds the transfer at the given average rates
+  curl_easy_setopt(curl_, CURLOPT_MAX_SEND_SPEED_LARGE, (curl_off_t)throttle_.upload);
+  curl_easy_setopt(curl_, CURLOPT_MAX_RECV_SPEED_LARGE, (curl_off_t)throttle_.download);
+
+  CURLcode res = curl_easy_perform(curl_);
+  curl_slist_free_all(hlist);
+
+  if(res != CURLE_OK) {
+    //curl codes are below 100, as with restclient-cpp
+    resRC.code = res;
+    resRC.body = res == CURLE_OPERATION_TIMEDOUT ? "Operation Timeout." : "Failed to query.";
+  } else {
+    long code = 0;
+    curl_easy_getinfo(curl_, CURLINFO_RESPONSE_CODE, &code);
+    resRC.code = (int)code;
+  }
+
+  curl_off_t val = 0;
+  if(curl_easy_getinfo(curl_, CURLINFO_SIZE_UPLOAD_T, &val) == CURLE_OK) {
+    info_.sent = (uint64_t)val;
+  }
+  if(curl_easy_getinfo(curl_, CURLINFO_SIZE_DOWNLOAD_T, &val) == CURLE_OK) {
+    info_.received = (uint64_t)val;
+  }
+  if(curl_easy_getinfo(curl_, CURLINFO_SPEED_UPLOAD_T, &val) == CURLE_OK) {
+    info_.upload_rate = (uint64_t)val;
+  }
+  if(curl_easy_getinfo(curl_, CURLINFO_SPEED_DOWNLOAD_T, &val) == CURLE_OK) {
+    info_.download_rate = (uint64_t)val;
+  }
+
+  long connects = 0;
+  if(curl_easy_getinfo(curl_, CURLINFO_NUM_CONNECTS, &connects) == CURLE_OK) {
+    info_.connects = (uint32_t)connects;
+  }
+  //the handshake time is 0 for a plain connection or a reused one
+  if(info_.connects && curl_easy_getinfo(curl_, CURLINFO_APPCONNECT_TIME_T, &val) == CURLE_OK) {
+    info_.tls_handshake = val > 0;
+  }
+  //a socket closed by either side is no longer returned
+  curl_socket_t sock = CURL_SOCKET_BAD;
+  if(curl_easy_getinfo(curl_, CURLINFO_ACTIVESOCKET, &sock) == CURLE_OK) {
+    info_.alive = sock != CURL_SOCKET_BAD;
+  }
+  return resRC;
+}
+
+// -------------------------
+// --- COMPRESSED OUTPUT ---
+// -------------------------
+
+struct compressed_filebuf::compressor {
+
+  ~compressor() {
+    if(zcs) {
+      ZSTD_freeCCtx(zcs);
+    }
+    if(gz_init) {
+      deflateEnd(&gz);
+    }
+    if(file) {
+      ::fclose(file);
+    }
+  }
+
+  bool init(codec cdc, int level) {
+    cdc_ = cdc;
+    if(cdc_ == zstd) {
+      if(!(zcs = ZSTD_createCCtx())) {
+        return false;
+      }
+      ZSTD_CCtx_setParameter(zcs, ZSTD_c_compressionLevel, level < 0 ? ZSTD_CLEVEL_DEFAULT : level);
+      out.resize(ZSTD_CStreamOutSize());
+    } else {
+      //a gzip header and trailer around the deflate stream
+      if(deflateInit2(&gz,
+                      level < 0 ? Z_DEFAULT_COMPRESSION : std::min(level, 9),
+                      Z_DEFLATED,
+                      15 + 16,
+                      8,
+                      Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+      }
+      gz_init = true;
+      out.resize(1 << 17);
+    }
+    return true;
+  }
+
+  //compresses in, the last call ends the stream
+  bool write(const char *in, size_t len, bool end) {
+    if(cdc_ == zstd) {
+      ZSTD_inBuffer zin = {in, len, 0};
+      for(;;) {
+        ZSTD_outBuffer zout = {out.data(), out.size(), 0};
+        size_t rem = ZSTD_compressStream2(zcs, &zout, &zin, end ? ZSTD_e_end : ZSTD_e_continue);
+        if(ZSTD_isError(rem) || ::fwrite(out.data(), 1, zout.pos, file) != zout.pos) {
+          return false;
+        }
+        if(end ? !rem : zin.pos == zin.size) {
+          return true;
+        }
+      }
+    }
+    gz.next_in = (Bytef *)in;
+    gz.avail_in = (uInt)len;
+    for(;;) {
+      gz.next_out = (Bytef *)out.data();
+      gz.avail_out = (uInt)out.size();
+      int res = deflate(&gz, end ? Z_FINISH : Z_NO_FLUSH);
+      if(res == Z_STREAM_ERROR) {
+        return false;
+      }
+      size_t produced = out.size() - gz.avail_out;
+      if(::fwrite(out.data(), 1, produced, file) != produced) {
+        return false;
+      }
+      if(end ? res == Z_STREAM_END : !gz.avail_in && gz.avail_out) {
+        return true;
+      }
+    }
+  }
+
+  codec cdc_ = zstd;
+  ::FILE *file = nullptr;
+  ZSTD_CCtx *zcs = nullptr;
+  z_stream gz{};
+  bool gz_init = false;
+  std::vector<char> out;
+};
+
+std::optional<compressed_filebuf::codec> compressed_filebuf::codec_of(const std::string &file_name)
+{
+  auto ends_with = [&](std::string_view ext) {
+    return file_name.size() > ext.size() &&
+           file_name.compare(file_name.size() - ext.size(), ext.size(), ext) == 0;
+  };
+  if(ends_with(".zst")) {
+    return zstd;
+  }
+  if(ends_with(".gz")) {
+    return gzip;
+  }
+  return std::nullopt;
+}
+
+compressed_filebuf::~compressed_filebuf()
+{
+  close();
+}
+
+bool compressed_filebuf::open(const std::string &file_name, codec cdc, int level)
+{
+  compressor_.reset(new compressor());
+  if(!(compressor_->file = ::fopen(file_name.c_str(), "wb")) || !compressor_->init(cdc, level)) {
+    compressor_.reset();
+    return false;
+  }
+  chunk_.resize(chunk_size);
+  setp(chunk_.data(), chunk_.data() + chunk_.size());
+  closing_ = false;
+  failed_ = false;
+  thread_ = std::thread(&compressed_filebuf::run, this);
+  return true;
+}
+
+bool compressed_filebuf::close()
+{
+  if(!thread_.joinable()) {
+    return !failed_;
+  }
+  hand_off();
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    closing_ = true;
+  }
+  cv_.notify_all();
+  thread_.join();
+  //buffered bytes reach the file only now
+  if(::fclose(compressor_->file)) {
+    failed_ = true;
+  }
+  compressor_->file = nullptr;
+  compressor_.reset();
+  setp(nullptr, nullptr);
+  return !failed_;
+}
+
+void compressed_filebuf::hand_off()
+{
+  size_t len = pptr() - pbase();
+  if(!len) {
+    return;
+  }
+  std::unique_lock<std::mutex> lock(mtx_);
+  cv_.wait(lock, [&] { return pending_.size() < max_pending; });
+  chunk_.resize(len);
+  pending_.emplace_back(std::move(chunk_));
+  if(free_.empty()) {
+    chunk_ = std::vector<char>();
+  } else {
+    chunk_ = std::move(free_.back());
+    free_.pop_back();
+  }
+  lock.unlock();
+  cv_.notify_all();
+
+  chunk_.resize(chunk_size);
+  setp(chunk_.data(), chunk_.data() + chunk_.size());
+}
+
+compressed_filebuf::int_type compressed_filebuf::overflow(int_type ch)
+{
+  if(!thread_.joinable() || failed_) {
+    return traits_type::eof();
+  }
+  hand_off();
+  if(!traits_type::eq_int_type(ch, traits_type::eof())) {
+    *pptr() = traits_type::to_char_type(ch);
+    pbump(1);
+  }
+  return traits_type::not_eof(ch);
+}
+
+std::streamsize compressed_filebuf::xsputn(const char *s, std::streamsize n)
+{
+  if(!thread_.joinable() || failed_) {
+    return 0;
+  }
+  std::streamsize done = 0;
+  while(done < n) {
+    std::streamsize room = epptr() - pptr();
+    if(!room) {
+      hand_off();
+      continue;
+    }
+    std::streamsize len = std::min(room, n - done);
+    std::memcpy(pptr(), s + done, len);
+    pbump((int)len);
+    done += len;
+  }
+  return done;
+}
+
+int compressed_filebuf::sync()
+{
+  if(thread_.joinable()) {
+    hand_off();
+  }
+  return failed_ ? -1 : 0;
+}
+
+void compressed_filebuf::run()
+{
+  for(;;) {
+    std::vector<char> chunk;
+    bool end;
+    {
+      std::unique_lock<std::mutex> lock(mtx_);
+      cv_.wait(lock, [&] { return closing_ || !pending_.empty(); });
+      end = pending_.empty();
+      if(!end) {
+        chunk = std::move(pending_.front());
+        pending_.pop_front();
+      }
+    }
+    cv_.notify_all();
+
+    //after a write error the chunks are dropped, callers are not blocked
+    if(!failed_ && !compressor_->write(chunk.data(), chunk.size(), end)) {
+      failed_ = true;
+    }
+    if(end) {
+      return;
+    }
+
+    std::lock_guard<std::mutex> lock(mtx_);
+    free_.emplace_back(std::move(chunk));
+  }
+}
+
 // ------------------
 // --- RYML UTILS ---
 // ------------------
@@ -107,15 +694,141 @@ void log_tree_node(ryml::ConstNodeRef node,
   logger.info("\n{}", ss.str());
 }
 
-void set_tree_node(ryml::Tree src_t,
+// the arena bytes a subtree needs, false when it holds references
+static bool subtree_arena_len(const ryml::Tree &t,
+                              size_t id,
+                              bool with_key,
+                              size_t &len)
+{
+  if(t.is_key_ref(id) || t.is_val_ref(id)) {
+    return false;
+  }
+  if(with_key && t.has_key(id)) {
+    len += t.key(id).len;
+    len += t.has_key_tag(id) ? t.key_tag(id).len : 0;
+    len += t.has_key_anchor(id) ? t.key_anchor(id).len : 0;
+  }
+  if(t.has_val(id)) {
+    len += t.val(id).len;
+  }
+  len += t.has_val_tag(id) ? t.val_tag(id).len : 0;
+  len += t.has_val_anchor(id) ? t.val_anchor(id).len : 0;
+  for(size_t ch = t.first_child(id); ch != ryml::NONE; ch = t.next_sibling(ch)) {
+    if(!subtree_arena_len(t, ch, t.is_map(id), len)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// a null scalar stays null, instead of becoming an empty string
+static ryml::csubstr arena_copy(ryml::Tree &to_t, ryml::csubstr str)
+{
+  return str.str ? ryml::csubstr(to_t.to_arena(str)) : str;
+}
+
+static void copy_node(const ryml::Tree &t,
+                      size_t id,
+                      ryml::NodeRef to,
+                      bool with_key)
+{
+  ryml::Tree &to_t = *to.tree();
+  if(with_key && t.has_key(id)) {
+    to.set_key(arena_copy(to_t, t.key(id)));
+    if(t.has_key_tag(id)) {
+      to.set_key_tag(arena_copy(to_t, t.key_tag(id)));
+    }
+    if(t.has_key_anchor(id)) {
+      to.set_key_anchor(arena_copy(to_t, t.key_anchor(id)));
+    }
+    if(t.is_key_quoted(id)) {
+      to |= ryml::KEYQUO;
+    }
+  }
+  if(t.is_map(id)) {
+    to |= ryml::MAP;
+  } else if(t.is_seq(id)) {
+    to |= ryml::SEQ;
+  } else if(t.has_val(id)) {
+    to.set_val(arena_copy(to_t, t.val(id)));
+    if(t.is_val_quoted(id)) {
+      to |= ryml::VALQUO;
+    }
+  }
+  if(t.has_val_tag(id)) {
+    to.set_val_tag(arena_copy(to_t, t.val_tag(id)));
+  }
+  if(t.has_val_anchor(id)) {
+    to.set_val_anchor(arena_copy(to_t, t.val_anchor(id)));
+  }
+  for(size_t ch = t.first_child(id); ch != ryml::NONE; ch = t.next_sibling(ch)) {
+    copy_node(t, ch, to.append_child(), t.is_map(id));
+  }
+}
+
+void set_tree_node(const ryml::Tree &src_t,
                    ryml::ConstNodeRef src_n,
                    ryml::NodeRef to_n,
                    std::vector<char> &buf)
 {
-  ryml::csubstr n_ser = ryml::emit_yaml(src_t, src_n.id(), ryml::substr{}, false);
-  buf.resize(n_ser.len);
-  n_ser = ryml::emit_yaml(src_t, src_n.id(), ryml::to_substr(buf), true);
-  ryml::parse_in_arena(n_ser, to_n);
+  //a seed is written into its parent, as parsing into it would do
+  ryml::NodeRef dest(to_n.tree(), to_n.id());
+  ryml::Tree &to_t = *dest.tree();
+  size_t src_id = src_n.id();
+  bool keyed = src_t.has_key(src_id);
+
+  //the structural copy handles everything but references, a copy into the source itself
+  //and an unkeyed container merged into a container of the other kind
+  bool structural = true;
+  size_t len = 0;
+  if(!subtree_arena_len(src_t, src_id, true, len)) {
+    structural = false;
+  } else if(&src_t == &to_t) {
+    for(size_t it = dest.id(); it != ryml::NONE; it = to_t.parent(it)) {
+      if(it == src_id) {
+        structural = false;
+        break;
+      }
+    }
+  }
+  if(structural && !keyed &&
+      ((src_t.is_map(src_id) && to_t.is_seq(dest.id())) ||
+       (src_t.is_seq(src_id) && to_t.is_map(dest.id())))) {
+    structural = false;
+  }
+
+  if(!structural) {
+    ryml::csubstr n_ser = ryml::emit_yaml(src_t, src_id, ryml::substr{}, false);
+    buf.resize(n_ser.len);
+    n_ser = ryml::emit_yaml(src_t, src_id, ryml::to_substr(buf), true);
+    ryml::parse_in_arena(n_ser, to_n);
+    return;
+  }
+
+  //one arena growth at most; src strings are read after it, so a same-tree copy stays valid
+  to_t.reserve_arena(to_t.arena_size() + len);
+
+  if(keyed) {
+    if(!to_t.is_map(dest.id())) {
+      dest |= ryml::MAP;
+    }
+    copy_node(src_t, src_id, dest.append_child(), true);
+  } else {
+    copy_node(src_t, src_id, dest, false);
+  }
+}
+
+void subtree_size(const ryml::Tree &t,
+                  size_t id,
+                  size_t &nodes,
+                  size_t &arena)
+{
+  ++nodes;
+  arena += t.has_key(id) ? t.key(id).len : 0;
+  arena += t.has_val(id) ? t.val(id).len : 0;
+  for(size_t ch = t.first_child(id); ch != ryml::NONE; ch = t.next_sibling(ch)) {
+    subtree_size(t, ch, nodes, arena);
+  }
 }
 
 // ------------
@@ -9,7 +9,19 @@
 #include <chrono>
 #include <optional>
 #include <ctime>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <array>
+#include <deque>
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <string_view>
+#include <charconv>
 #include <dirent.h>
+#include <strings.h>
 #define PATH_MAX_LEN 2048
 
 #include "restclient-cpp/connection.h"
@@ -29,44 +41,87 @@
 
 #define key_access_key      "accessKey"
 #define key_auth            "auth"
+#define key_best            "best"
 #define key_body            "body"
+#define key_body_file       "bodyFile"
 #define key_categorization  "categorization"
 #define key_code            "code"
+#define key_concurrency     "concurrency"
+#define key_count           "count"
+#define key_connections     "connections"
+#define key_conversation    "conversation"
 #define key_conversations   "conversations"
 #define key_data            "data"
+#define key_download        "download"
 #define key_dump            "dump"
 #define key_enabled         "enabled"
 #define key_error           "error"
 #define key_error_occurred  "errorOccurred"
+#define key_errors          "errors"
+#define key_failed          "failed"
+#define key_file            "file"
+#define key_first           "first"
 #define key_for             "for"
 #define key_format          "format"
 #define key_headers         "headers"
 #define key_host            "host"
 #define key_id              "id"
+#define key_iterations      "iterations"
+#define key_last            "last"
+#define key_max             "max"
 #define key_method          "method"
+#define key_min             "min"
 #define key_mock            "mock"
 #define key_msec            "msec"
+#define key_new             "new"
 #define key_nsec            "nsec"
 #define key_before          "before"
 #define key_after           "after"
 #define key_out             "out"
+#define key_p50             "p50"
+#define key_p90             "p90"
+#define key_p99             "p99"
+#define key_pass            "pass"
+#define key_peak            "peak"
 #define key_query_string    "queryString"
+#define key_received        "received"
 #define key_region          "region"
+#define key_replay          "replay"
+#define key_request         "request"
 #define key_requests        "requests"
+#define key_reused          "reused"
 #define key_response        "response"
+#define key_rounds          "rounds"
 #define key_rtt             "rtt"
+#define key_samples         "samples"
+#define key_search          "search"
 #define key_sec             "sec"
 #define key_secret_key      "secretKey"
+#define key_sent            "sent"
 #define key_service         "service"
+#define key_slo             "slo"
 #define key_signed_headers  "signedHeaders"
+#define key_speed           "speed"
 #define key_stats           "stats"
+#define key_steps           "steps"
+#define key_throttle        "throttle"
+#define key_throughput      "throughput"
+#define key_tls             "tls"
+#define key_ts              "ts"
+#define key_upload          "upload"
 #define key_uri             "uri"
 #define key_usec            "usec"
 
+#define STR_AGGREGATE       "aggregate"
+#define STR_CBOR            "cbor"
+#define STR_MSGPACK         "msgpack"
 #define STR_TRUE            "true"
 #define STR_FALSE           "false"
 #define STR_JSON            "json"
+#define STR_NDJSON          "ndjson"
+#define STR_XML             "xml"
 #define STR_YAML            "yaml"
+#define STR_MAX             "max"
 #define YAML_DOC_SEP        "---"
 
 #define HTTP_HEAD           "HEAD"
@@ -84,6 +139,8 @@ struct env;
 struct scenario;
 struct conversation;
 struct request;
+struct replay;
+struct search;
 struct response;
 }
 
@@ -100,21 +157,92 @@ struct cfg {
   std::string out_channel = "stdout";
   std::string out_format = STR_YAML;
 
+  //the level of a .gz or .zst output channel, < 0 means the codec's default
+  int out_compression_level = -1;
+
   std::string evt_log_channel = "stderr";
   std::string evt_log_level = "inf";
 
+  uint32_t workers = 1;
+
+  //keep a connection per host open across requests, implied by more than one worker
+  bool keep_alive = false;
+
   bool daemon = false;
   uint16_t endpoint_port = 8080;
   uint32_t endpoint_concurrency = 2;
 
   bool no_out_ = false;
+
+  //emit finished requests and conversations as they complete
+  bool stream_out_ = false;
+
+  //the binary format the input is decoded from into yaml, empty when not decoding
+  std::string decode;
+};
+
+// transfer rates in bytes per second, 0 means unlimited
+struct throttle {
+  uint64_t upload = 0;
+  uint64_t download = 0;
+};
+
+// how the output trees of the scenarios run so far compared to their estimated size,
+// shared by the contexts of a daemon so that reservations adapt across documents
+struct capacity_hint {
+
+  // folds the actual sizes of an output tree into the ratios
+  void learn(size_t est_nodes, size_t nodes, size_t est_arena, size_t arena) {
+    nodes_pct_ = fold(nodes_pct_, est_nodes, nodes);
+    arena_pct_ = fold(arena_pct_, est_arena, arena);
+  }
+
+  size_t nodes(size_t est_nodes) const {
+    return est_nodes * nodes_pct_ / 100;
+  }
+
+  size_t arena(size_t est_arena) const {
+    return est_arena * arena_pct_ / 100;
+  }
+
+  // a moving average, bounded so that an outlier cannot make the next reservation huge
+  static uint32_t fold(uint32_t pct, size_t est, size_t actual) {
+    if(!est) {
+      return pct;
+    }
+    uint32_t sample = (uint32_t)std::clamp<size_t>(actual * 100 / est, 25, 800);
+    return (pct * 3 + sample) / 4;
+  }
+
+  // actual over estimated size, in percent; racing updates just lose a sample
+  std::atomic<uint32_t> nodes_pct_ = 100;
+  std::atomic<uint32_t> arena_pct_ = 100;
 };
 
-const ryml::Tree &get_default_out_options();
-const ryml::Tree &get_default_scenario_out_options();
-const ryml::Tree &get_default_conversation_out_options();
-const ryml::Tree &get_default_request_out_options();
-const ryml::Tree &get_default_response_out_options();
+enum http_method {
+  http_unknown,
+  http_get,
+  http_post,
+  http_put,
+  http_delete,
+  http_head
+};
+
+inline http_method method_from(const std::string &str)
+{
+  if(str == HTTP_GET) {
+    return http_get;
+  } else if(str == HTTP_POST) {
+    return http_post;
+  } else if(str == HTTP_PUT) {
+    return http_put;
+  } else if(str == HTTP_DELETE) {
+    return http_delete;
+  } else if(str == HTTP_HEAD) {
+    return http_head;
+  }
+  return http_unknown;
+}
 
 enum resolution {
   nanoseconds,
@@ -123,6 +251,62 @@ enum resolution {
   seconds
 };
 
+// the dump and format options of an output scope, resolved from its out node
+struct out_options {
+
+  enum body_format {
+    body_string,
+    body_json,
+    body_xml
+  };
+
+  // the keys whose dump is tested while rendering, each a bit of hidden_;
+  // any other listed key is only removed from the output
+  enum dump_key {
+    dump_out,
+    dump_query_string,
+    dump_data,
+    dump_auth
+  };
+
+  static std::optional<dump_key> dump_key_of(std::string_view key);
+
+  // whether key is rendered, a key not listed is
+  bool dumps(dump_key key) const {
+    return !(hidden_ & (1u << key));
+  }
+
+  // sets a listed key, or lists it after the others
+  void set_dump(std::string_view key, bool val);
+  void set_format(std::string_view key, std::string_view val);
+
+  // the options an out node sets over these ones
+  void merge(ryml::ConstNodeRef out_node);
+
+  // writes the dump and format maps into out_node
+  void render(ryml::NodeRef out_node) const;
+
+  // dump keys in order, with whether they are rendered;
+  // any output key can be listed, so they are few but open-ended
+  std::vector<std::pair<std::string, bool>> dump_;
+
+  // format keys in order, with their literal
+  std::vector<std::pair<std::string, std::string>> format_;
+
+  // the dump_keys listed as not rendered
+  uint32_t hidden_ = 0;
+
+  // the typed formats
+  resolution rtt_ = nanoseconds;
+  body_format body_ = body_string;
+};
+
+const out_options &get_default_out_options();
+const out_options &get_default_scenario_out_options();
+const out_options &get_default_conversation_out_options();
+const out_options &get_default_request_out_options();
+const out_options &get_default_response_out_options();
+
 inline resolution from_literal(const std::string &str)
 {
   if(str == key_nsec) {
@@ -236,6 +420,396 @@ inline bool ends_with(const std::string &str, const std::string &match)
   }
 }
 
+// parses a rate like: 65536, 64KiB/s, 1.5MB/s into bytes per second
+inline std::optional<uint64_t> parse_rate(const std::string &str)
+{
+  static const std::pair<const char *, uint64_t> units[] = {
+    {"", 1}, {"B", 1},
+    {"KB", 1000}, {"KiB", 1024},
+    {"MB", 1000000}, {"MiB", 1048576},
+    {"GB", 1000000000}, {"GiB", 1073741824}
+  };
+
+  char *end = nullptr;
+  double value = std::strtod(str.c_str(), &end);
+  if(end == str.c_str() || value < 0) {
+    return std::nullopt;
+  }
+  std::string unit(end);
+  trim(unit);
+  if(ends_with(unit, "/s")) {
+    unit.erase(unit.size() - 2);
+  }
+  for(const auto &it : units) {
+    if(unit == it.first) {
+      return (uint64_t)(value * it.second);
+    }
+  }
+  return std::nullopt;
+}
+
+// locale-free conversions: a failed or partial parse is reported as nullopt
+template <typename T>
+inline std::optional<T> parse(std::string_view str)
+{
+  T value{};
+  const char *last = str.data() + str.size();
+  auto [ptr, ec] = std::from_chars(str.data(), last, value);
+  if(str.empty() || ec != std::errc() || ptr != last) {
+    return std::nullopt;
+  }
+  return value;
+}
+
+template <>
+inline std::optional<bool> parse<bool>(std::string_view str)
+{
+  auto is = [&](std::string_view lit) {
+    return str.size() == lit.size() && strncasecmp(str.data(), lit.data(), lit.size()) == 0;
+  };
+  if(is("true") || str == "1") {
+    return true;
+  } else if(is("false") || str == "0") {
+    return false;
+  }
+  return std::nullopt;
+}
+
+template <typename T>
+inline std::string to_str(T value)
+{
+  char buf[32];
+  auto [ptr, ec] = std::to_chars(buf, buf + sizeof(buf), value);
+  return std::string(buf, ec == std::errc() ? ptr : buf);
+}
+
+// the type a yaml/json scalar carries
+enum scalar_kind {
+  scalar_null,
+  scalar_bool,
+  scalar_int,
+  scalar_float,
+  scalar_string
+};
+
+// quoted scalars are strings, plain ones are typed by their content
+inline scalar_kind scalar_kind_of(ryml::ConstNodeRef node)
+{
+  if(node.val_is_null()) {
+    return scalar_null;
+  }
+  if(node.is_val_quoted()) {
+    return scalar_string;
+  }
+  ryml::csubstr val = node.val();
+  std::string_view str(val.str, val.len);
+  if(str.empty()) {
+    return scalar_string;
+  }
+  if(str == "true" || str == "false") {
+    return scalar_bool;
+  }
+  //inf and nan stay strings
+  if(!(std::isdigit((unsigned char)str[0]) || str[0] == '-' || str[0] == '+' || str[0] == '.')) {
+    return scalar_string;
+  }
+  if(parse<int64_t>(str[0] == '+' ? str.substr(1) : str)) {
+    return scalar_int;
+  }
+  if(parse<double>(str[0] == '+' ? str.substr(1) : str)) {
+    return scalar_float;
+  }
+  return scalar_string;
+}
+
+// whether a double holds the integer exactly, as JavaScript's Number.isSafeInteger
+inline bool is_safe_integer(int64_t num)
+{
+  constexpr int64_t max_safe = ((int64_t)1 << 53) - 1;
+  return num >= -max_safe && num <= max_safe;
+}
+
+// what curl measured of the last transfer of a connection
+struct transfer_info {
+  // request body bytes sent and response body bytes received
+  uint64_t sent = 0;
+  uint64_t received = 0;
+
+  // average rates over the whole transfer, in bytes per second
+  uint64_t upload_rate = 0;
+  uint64_t download_rate = 0;
+
+  // the connections opened for the transfer, 0 when an open one was reused
+  uint32_t connects = 0;
+
+  // the transfer opened a connection with a TLS handshake
+  bool tls_handshake = false;
+
+  // the socket is still open after the transfer
+  bool alive = false;
+};
+
+// an http connection to a host over a curl easy handle, which keeps its socket
+// open across requests; requests are sent as restclient-cpp sends them.
+// The transfer itself is paced by curl when a throttle is set.
+class http_connection {
+  public:
+    explicit http_connection(const std::string &base_url);
+    ~http_connection();
+
+    http_connection(const http_connection &) = delete;
+    http_connection &operator=(const http_connection &) = delete;
+
+    // the headers of the next request
+    void set_headers(const RestClient::HeaderFields &headers) {
+      headers_ = headers;
+    }
+
+    // the rates of the next transfers, 0 means unlimited
+    void set_throttle(const throttle &thr) {
+      throttle_ = thr;
+    }
+
+    RestClient::Response get(const std::string &uri);
+    RestClient::Response post(const std::string &uri, const std::string &data);
+    RestClient::Response put(const std::string &uri, const std::string &data);
+    RestClient::Response del(const std::string &uri);
+    RestClient::Response head(const std::string &uri);
+
+    const transfer_info &last_transfer() const {
+      return info_;
+    }
+
+  private:
+    RestClient::Response perform(http_method method,
+                                 const std::string &uri,
+                                 const std::string *data);
+
+    CURL *curl_ = nullptr;
+    std::string base_url_;
+    RestClient::HeaderFields headers_;
+    throttle throttle_;
+    transfer_info info_;
+};
+
+// per-host connection counters
+struct conn_stats {
+  uint32_t created = 0;
+  uint32_t reused = 0;
+  uint32_t errors = 0;
+  uint32_t tls = 0;
+  uint32_t peak = 0;
+
+  void merge(const conn_stats &other) {
+    created += other.created;
+    reused += other.reused;
+    errors += other.errors;
+    tls += other.tls;
+    peak = std::max(peak, other.peak);
+  }
+};
+
+// per-host count of the open sockets, shared by all the scenarios of a context
+struct conn_gauge {
+
+  // returns the sockets open to host, this one included
+  uint32_t open(const std::string &host) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return ++open_[host];
+  }
+
+  void close(const std::string &host) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto it = open_.find(host);
+    if(it != open_.end() && it->second) {
+      --it->second;
+    }
+  }
+
+  std::mutex mtx_;
+  std::unordered_map<std::string, uint32_t> open_;
+};
+
+// stable small-integer handles for strings, a string is materialized once when first interned
+struct interner {
+  typedef uint32_t handle;
+
+  handle intern(std::string_view str) {
+    auto it = handles_.find(str);
+    if(it != handles_.end()) {
+      return it->second;
+    }
+    strs_.emplace_back(str);
+    handle h = (handle)(strs_.size() - 1);
+    handles_.emplace(strs_.back(), h);
+    return h;
+  }
+
+  std::optional<handle> find(std::string_view str) const {
+    auto it = handles_.find(str);
+    if(it == handles_.end()) {
+      return std::nullopt;
+    }
+    return it->second;
+  }
+
+  const std::string &str(handle h) const {
+    return strs_[h];
+  }
+
+  void clear() {
+    handles_.clear();
+    strs_.clear();
+  }
+
+  // a deque never moves its strings, so the keys can view them
+  std::deque<std::string> strs_;
+  std::unordered_map<std::string_view, handle> handles_;
+};
+
+// log-linear histogram: 16 sub-buckets per power of two, ~6% relative error
+struct histogram {
+  static constexpr uint32_t sub_bits = 4;
+  static constexpr uint32_t sub_count = 1 << sub_bits;
+  static constexpr uint32_t bucket_count = (64 - sub_bits + 1) * sub_count;
+
+  void reset() {
+    buckets_.fill(0);
+    count_ = 0;
+  }
+
+  void record(uint64_t value) {
+    ++buckets_[index_of(value)];
+    ++count_;
+  }
+
+  void merge(const histogram &other) {
+    for(uint32_t i = 0; i < bucket_count; ++i) {
+      buckets_[i] += other.buckets_[i];
+    }
+    count_ += other.count_;
+  }
+
+  // upper bound of the bucket holding the q-th quantile, q in [0, 1]
+  uint64_t quantile(double q) const {
+    if(!count_) {
+      return 0;
+    }
+    uint64_t rank = std::max<uint64_t>(1, (uint64_t)std::ceil(q * count_));
+    uint64_t seen = 0;
+    for(uint32_t i = 0; i < bucket_count; ++i) {
+      if((seen += buckets_[i]) >= rank) {
+        return i + 1 < bucket_count ? lower_of(i + 1) - 1 : UINT64_MAX;
+      }
+    }
+    return UINT64_MAX;
+  }
+
+  static uint32_t index_of(uint64_t value) {
+    if(value < sub_count) {
+      return (uint32_t)value;
+    }
+    uint32_t msb = (uint32_t)std::bit_width(value) - 1;
+    uint32_t sub = (uint32_t)(value >> (msb - sub_bits)) & (sub_count - 1);
+    return (msb - sub_bits + 1) * sub_count + sub;
+  }
+
+  static uint64_t lower_of(uint32_t idx) {
+    if(idx < sub_count) {
+      return idx;
+    }
+    return (uint64_t)(sub_count + idx % sub_count) << (idx / sub_count - 1);
+  }
+
+  std::array<uint64_t, bucket_count> buckets_{};
+  uint64_t count_ = 0;
+};
+
+// writes lines to a stream from a thread of its own, keeping the i/o off the callers' path
+struct line_writer {
+  ~line_writer() {
+    stop();
+  }
+
+  void start(std::ostream &out);
+
+  // whether lines are being written, not the case in daemon mode
+  bool started() const {
+    return thread_.joinable();
+  }
+
+  // queues a line, the writer appends the newline;
+  // waits while the queue is full, so that a slow output slows the callers down
+  void write(std::string &&line);
+
+  // drains the queue and joins the writer thread
+  void stop();
+
+  void run();
+
+  static constexpr size_t max_pending = 1 << 16;
+
+  std::ostream *out_ = nullptr;
+  std::mutex mtx_;
+  std::condition_variable cv_;
+  std::vector<std::string> queue_;
+  bool stop_ = false;
+  std::thread thread_;
+};
+
+// appends str as a quoted json string
+void append_json_string(std::string &out, std::string_view str);
+
+// a file streambuf compressing from a thread of its own: the callers fill a chunk,
+// the compressor thread deflates it while the next one is filled
+class compressed_filebuf : public std::streambuf {
+  public:
+    enum codec {
+      gzip,
+      zstd
+    };
+
+    // the codec a file name asks for by its extension, nullopt for a plain file
+    static std::optional<codec> codec_of(const std::string &file_name);
+
+    ~compressed_filebuf();
+
+    // level < 0 means the codec's default
+    bool open(const std::string &file_name, codec cdc, int level);
+
+    // hands off the pending bytes, ends the compressed stream and closes the file;
+    // false when any of the output could not be written
+    bool close();
+
+  protected:
+    int_type overflow(int_type ch) override;
+    std::streamsize xsputn(const char *s, std::streamsize n) override;
+    int sync() override;
+
+  private:
+    struct compressor;
+
+    void hand_off();
+    void run();
+
+    static constexpr size_t chunk_size = 1 << 20;
+
+    // chunks handed off, bounded so that a slow disk slows the callers down
+    static constexpr size_t max_pending = 8;
+
+    std::unique_ptr<compressor> compressor_;
+    std::vector<char> chunk_;
+    std::deque<std::vector<char>> pending_;
+    std::vector<std::vector<char>> free_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    bool closing_ = false;
+
+    // set by the compressor thread on a write error, the buffer then fails its stream
+    std::atomic<bool> failed_ = false;
+    std::thread thread_;
+};
+
 inline void base_name(const std::string &input,
                       std::string &base_path,
                       std::string &file_name)
@@ -300,18 +874,52 @@ struct RymlErrorHandler {
     }
   }
 
+  // installation, a no-op while pinned
+  void install() {
+    if(!pinned_) {
+      ryml::set_callbacks(callbacks());
+    }
+  }
+
+  void uninstall() {
+    if(!pinned_) {
+      ryml::set_callbacks(defaults);
+    }
+  }
+
+  // pinning, ryml callbacks are process-wide so concurrent workers must not toggle them
+  void pin() {
+    ryml::set_callbacks(callbacks());
+    pinned_ = true;
+  }
+
+  void unpin() {
+    pinned_ = false;
+    ryml::set_callbacks(defaults);
+  }
+
   RymlErrorHandler() : defaults(ryml::get_callbacks()) {}
   ryml::Callbacks defaults;
+  std::atomic<bool> pinned_ = false;
 };
 
 void log_tree_node(ryml::ConstNodeRef node,
                    spdlog::logger &logger);
 
-void set_tree_node(ryml::Tree src_t,
+// copies src_n into to_n: a keyed src_n is added as a child of to_n,
+// an unkeyed one (root, sequence item) has its content merged into to_n;
+// scalars are copied into to_n's arena, quoting, tags and anchors are kept
+void set_tree_node(const ryml::Tree &src_t,
                    ryml::ConstNodeRef src_n,
                    ryml::NodeRef to_n,
                    std::vector<char> &buf);
 
+// adds the node count of the subtree at id and the arena bytes of its scalars
+void subtree_size(const ryml::Tree &t,
+                  size_t id,
+                  size_t &nodes,
+                  size_t &arena);
+
 // ------------
 // --- AUTH ---
 // ------------
@@ -384,6 +992,54 @@ inline void clear_map_node_put_key_val(ryml::NodeRef map_node,
   map_node[ryml::to_csubstr(stable_key)] << val;
 }
 
+inline void put_conn_stats(ryml::NodeRef statistics,
+                           const std::unordered_map<std::string, conn_stats> &connections)
+{
+  if(connections.empty()) {
+    return;
+  }
+  ryml::NodeRef connections_node = statistics[key_connections];
+  connections_node |= ryml::MAP;
+  for(const auto &it : connections) {
+    ryml::NodeRef host = connections_node[connections_node.to_arena(it.first)];
+    host |= ryml::MAP;
+    host[key_new] << it.second.created;
+    host[key_reused] << it.second.reused;
+    host[key_errors] << it.second.errors;
+    host[key_tls] << it.second.tls;
+    host[key_peak] << it.second.peak;
+  }
+}
+
+// finds the next {{...}} placeholder, on a single line, starting at from;
+// open is set at the opening braces, close past the closing ones
+inline bool find_placeholder(ryml::csubstr str,
+                             size_t from,
+                             size_t &open,
+                             size_t &close)
+{
+  while((open = str.find("{{", from)) != ryml::npos) {
+    size_t end = str.find("}}", open + 2);
+    if(end == ryml::npos) {
+      return false;
+    }
+    size_t eol = str.find('\n', open + 2);
+    if(eol != ryml::npos && eol < end) {
+      from = eol + 1;
+      continue;
+    }
+    close = end + 2;
+    return true;
+  }
+  return false;
+}
+
+inline bool has_placeholder(ryml::csubstr str)
+{
+  size_t open, close;
+  return find_placeholder(str, 0, open, close);
+}
+
 class str_tok {
   public:
     explicit str_tok(const std::string &str);
@@ -411,4 +1067,78 @@ class str_tok {
     bool ret_delims_, delims_changed_;
 };
 
+// a set of delimiters, as a 256 bit lookup table built at compile time
+struct delim_set {
+  constexpr explicit delim_set(const char *delimiters) {
+    for(; *delimiters; ++delimiters) {
+      unsigned char c = (unsigned char)*delimiters;
+      bits_[c >> 6] |= (uint64_t)1 << (c & 63);
+    }
+  }
+
+  constexpr bool has(char ch) const {
+    unsigned char c = (unsigned char)ch;
+    return bits_[c >> 6] & ((uint64_t)1 << (c & 63));
+  }
+
+  uint64_t bits_[4] = {0, 0, 0, 0};
+};
+
+// str_tok over a string_view: tokens are views of the tokenized string;
+// the delimiters are held by value, so a temporary set does not dangle
+class sv_tok {
+  public:
+    constexpr sv_tok(std::string_view str, const delim_set &delimiters) :
+      str_(str),
+      delimiters_(delimiters)
+    {}
+
+    constexpr bool next_token(std::string_view &out,
+                              bool return_delimiters = false,
+                              bool *is_delimit = nullptr) {
+      size_t start = position_;
+      if(!return_delimiters) {
+        while(start < str_.size() && delimiters_.has(str_[start])) {
+          ++start;
+        }
+      }
+      if(start >= str_.size()) {
+        position_ = start;
+        return false;
+      }
+      size_t end = start;
+      while(end < str_.size() && !delimiters_.has(str_[end])) {
+        ++end;
+      }
+      if(is_delimit) {
+        *is_delimit = (end == start);
+      }
+      if(end == start) {
+        //a delimiter returned as a token
+        ++end;
+      }
+      out = str_.substr(start, end - start);
+      position_ = end;
+      return true;
+    }
+
+    constexpr void reset() {
+      position_ = 0;
+    }
+
+    constexpr size_t position() const {
+      return position_;
+    }
+
+    //resume tokenizing from pos, after the caller scanned a span on its own
+    constexpr void seek(size_t pos) {
+      position_ = pos;
+    }
+
+  private:
+    std::string_view str_;
+    delim_set delimiters_;
+    size_t position_ = 0;
+};
+
 }
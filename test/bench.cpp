@@ -0,0 +1,57 @@
+#include "utils.h"
+#include <iomanip>
+
+// microbenchmark: utils::str_tok vs utils::sv_tok over typical property paths
+
+static const std::string paths[] = {
+  ".[0][1].response.body.Owner.DisplayName",
+  "conv_a.requests[2].response.headers.etag",
+  ".conversations[0].requests[12].response.code",
+  "req_42.response.body.ListBucketResult.Contents[7].Key"
+};
+
+static constexpr utils::delim_set bench_delimits(".[]");
+
+template <typename F>
+static void run(const char *name, uint32_t iterations, F &&tokenize)
+{
+  size_t sink = 0;
+  std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  for(uint32_t i = 0; i < iterations; ++i) {
+    for(const auto &path : paths) {
+      sink += tokenize(path);
+    }
+  }
+  std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - t0;
+  std::cout << std::left << std::setw(8) << name
+            << std::right << std::setw(10) << std::fixed << std::setprecision(1)
+            << elapsed.count() / (iterations * std::size(paths)) << " ns/path"
+            << "  (" << sink << " tokens)" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+  uint32_t iterations = argc > 1 ? (uint32_t)std::strtoul(argv[1], nullptr, 10) : 1000000;
+
+  run("str_tok", iterations, [](const std::string &path) -> size_t {
+    utils::str_tok tknz(path);
+    std::string tkn;
+    size_t count = 0;
+    while(tknz.next_token(tkn, ".[]", true)) {
+      count += tkn.size() ? 1 : 0;
+    }
+    return count;
+  });
+
+  run("sv_tok", iterations, [](const std::string &path) -> size_t {
+    utils::sv_tok tknz(path, bench_delimits);
+    std::string_view tkn;
+    size_t count = 0;
+    while(tknz.next_token(tkn, true)) {
+      count += tkn.size() ? 1 : 0;
+    }
+    return count;
+  });
+
+  return 0;
+}
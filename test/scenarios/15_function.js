@@ -0,0 +1,13 @@
+function readLazyData() {
+  let request = out.conversations[0].requests[0];
+  assert("readLazyData [data]", request.data == "lazy-2");
+  assert("readLazyData [headers]", request.headers["x-len"] === "1000");
+  return "" + request.data;
+}
+
+function readBigIntegers() {
+  let tags = out.conversations[0].requests[0].tags;
+  return typeof tags.safe + ":" + tags.safe + "|" +
+         typeof tags.big + ":" + tags.big + "|" +
+         typeof tags.huge + ":" + tags.huge;
+}
@@ -17,6 +17,40 @@ int main(int argc, char *argv[])
   return res;
 }
 
+test_server::test_server() :
+  http_endpoint_(std::make_shared<Pistache::Http::Endpoint>(Pistache::Address(Pistache::Ipv4::loopback(),
+                                                                              Pistache::Port(0))))
+{
+  using namespace Pistache::Rest;
+  http_endpoint_->init(Pistache::Http::Endpoint::options().threads(1));
+  Routes::Put(router_, "/upload", Routes::bind(&test_server::do_put_upload, this));
+  Routes::Get(router_, "/download", Routes::bind(&test_server::do_get_download, this));
+  http_endpoint_->setHandler(router_.handler());
+  http_endpoint_->serveThreaded();
+}
+
+test_server::~test_server()
+{
+  http_endpoint_->shutdown();
+}
+
+uint16_t test_server::port() const
+{
+  return http_endpoint_->getPort();
+}
+
+void test_server::do_put_upload(const Pistache::Rest::Request &request,
+                                Pistache::Http::ResponseWriter response)
+{
+  response.send(Pistache::Http::Code::Ok, std::to_string(request.body().size()));
+}
+
+void test_server::do_get_download(const Pistache::Rest::Request &request,
+                                  Pistache::Http::ResponseWriter response)
+{
+  response.send(Pistache::Http::Code::Ok, std::string(200000, 'x'));
+}
+
 void cbox_test::SetUp()
 {
   env_.reset(new cbox::env());
@@ -27,6 +61,75 @@ void cbox_test::TearDown()
 {
   env_.release();
   spdlog::drop_all();
+  for(const auto &path : tmp_files_) {
+    std::remove(path.c_str());
+  }
+}
+
+std::string cbox_test::tmp_file(const char *name)
+{
+  std::string path = testing::TempDir();
+  path += "cbx_";
+  path += testing::UnitTest::GetInstance()->current_test_info()->name();
+  path += '_';
+  path += name;
+  tmp_files_.push_back(path);
+  return path;
+}
+
+int cbox_test::run_scenario(const char *in_name,
+                            ryml::Tree &out,
+                            const std::vector<std::pair<std::string, std::string>> &vars)
+{
+  env_->event_log_->set_level(spdlog::level::level_enum::off);
+  env_->cfg_.in_path = "scenarios";
+  env_->cfg_.in_name = in_name;
+  if(!vars.empty()) {
+    std::ifstream in(std::string("scenarios/") + in_name);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    std::string text = ss.str();
+    for(const auto &var : vars) {
+      for(size_t at; (at = text.find(var.first)) != std::string::npos;) {
+        text.replace(at, var.first.size(), var.second);
+      }
+    }
+    std::string path = tmp_file(in_name);
+    std::ofstream(path) << text;
+    env_->cfg_.in_path = testing::TempDir();
+    env_->cfg_.in_name = path.substr(env_->cfg_.in_path.size());
+  }
+  env_->cfg_.out_format = STR_YAML;
+  env_->cfg_.out_channel = tmp_file("out.yaml");
+  int res = env_->exec();
+
+  std::vector<char> buf;
+  int error = 0;
+  out.clear();
+  out.clear_arena();
+  if(utils::file_get_contents(env_->cfg_.out_channel.c_str(), buf, nullptr, error)) {
+    ryml::parse_in_arena(ryml::csubstr(buf.data(), buf.size()), &out);
+  }
+  return res;
+}
+
+ryml::ConstNodeRef cbox_test::first_doc(const ryml::Tree &out)
+{
+  ryml::ConstNodeRef root = out.rootref();
+  return root.is_stream() ? root.first_child() : root;
+}
+
+ryml::ConstNodeRef cbox_test::requests_of(ryml::ConstNodeRef scenario_out, size_t conv_idx)
+{
+  return scenario_out["conversations"][conv_idx]["requests"];
+}
+
+std::string cbox_test::str_of(ryml::ConstNodeRef node)
+{
+  if(!node.valid() || !node.has_val()) {
+    return "<none>";
+  }
+  return std::string(node.val().str, node.val().len);
 }
 
 TEST_F(cbox_test, NoPathNonExistingInputFile)
@@ -60,3 +163,1073 @@ TEST_F(cbox_test, HEAD_1Conv_1Req)
   env_->cfg_.in_name = "1_head1conv1req.json";
   ASSERT_EQ(env_->exec(), 0);
 }
+
+TEST_F(cbox_test, Replay_1Conv_3Req)
+{
+  ryml::Tree out;
+  ASSERT_EQ(run_scenario("2_replay.json", out), 0);
+  ryml::ConstNodeRef requests = requests_of(first_doc(out));
+  ASSERT_EQ(requests.num_children(), 3u);
+
+  //the query string is split out of the logged uri, the body is sent verbatim
+  ASSERT_EQ(str_of(requests[0]["method"]), "PUT");
+  ASSERT_EQ(str_of(requests[0]["uri"]), "bucket/obj");
+  ASSERT_EQ(str_of(requests[0]["queryString"]), "partNumber=1");
+  ASSERT_EQ(str_of(requests[0]["data"]), "{{not.a.template}}");
+  ASSERT_EQ(str_of(requests[0]["response"]["code"]), "200");
+
+  ASSERT_EQ(str_of(requests[1]["method"]), "GET");
+  ASSERT_EQ(str_of(requests[1]["headers"]["x-replayed"]), "{{yes}}");
+
+  //a recorded auth is dropped, the replay defines none
+  ASSERT_EQ(str_of(requests[2]["method"]), "DELETE");
+  ASSERT_FALSE(requests[2].has_child("auth"));
+  ASSERT_EQ(str_of(requests[2]["response"]["code"]), "204");
+}
+
+TEST_F(cbox_test, Search_2Conv_1Req)
+{
+  ryml::Tree out;
+  ASSERT_EQ(run_scenario("3_search.json", out), 0);
+  ryml::ConstNodeRef conversations = first_doc(out)["conversations"];
+
+  //every step meets the slo: the concurrency doubles up to max
+  ryml::ConstNodeRef search = conversations[0]["search"];
+  ryml::ConstNodeRef steps = search["steps"];
+  ASSERT_EQ(steps.num_children(), 3u);
+  for(size_t i = 0; i < 3; ++i) {
+    ASSERT_EQ(str_of(steps[i]["concurrency"]), std::to_string(1 << i));
+    ASSERT_EQ(str_of(steps[i]["requests"]), std::to_string(2 << i));
+    ASSERT_GT(std::stod(str_of(steps[i]["throughput"])), 0);
+    ASSERT_EQ(str_of(steps[i]["pass"]), "true");
+  }
+  ASSERT_EQ(str_of(search["best"]), "4");
+
+  //not even min meets the slo, with the widest max clamped
+  search = conversations[1]["search"];
+  ASSERT_EQ(search["steps"].num_children(), 1u);
+  ASSERT_EQ(str_of(search["steps"][0]["errors"]), "100.00");
+  ASSERT_EQ(str_of(search["steps"][0]["pass"]), "false");
+  ASSERT_EQ(str_of(search["best"]), "0");
+}
+
+TEST_F(cbox_test, Expr_1Conv_2Req)
+{
+  ryml::Tree out;
+  ASSERT_EQ(run_scenario("4_expr.json", out), 0);
+  ryml::ConstNodeRef requests = requests_of(first_doc(out));
+  ASSERT_EQ(requests.num_children(), 4u);
+
+  //i per iteration, the ternary over it
+  ASSERT_EQ(str_of(requests[0]["uri"]), "obj-0");
+  ASSERT_EQ(str_of(requests[0]["data"]), "even");
+  ASSERT_EQ(str_of(requests[1]["uri"]), "obj-1");
+  ASSERT_EQ(str_of(requests[1]["data"]), "odd");
+  ASSERT_EQ(str_of(requests[2]["uri"]), "obj-2");
+  ASSERT_EQ(str_of(requests[2]["data"]), "even");
+
+  //ref() returns a string, so + concatenates
+  ASSERT_EQ(str_of(requests[3]["uri"]), "2001/19");
+}
+
+TEST_F(cbox_test, Expr_Eval)
+{
+  std::mt19937_64 rng(1);
+  std::string error;
+  auto eval = [&](std::string_view src, uint32_t i) -> std::optional<std::string> {
+    cbox::expression expr;
+    if(!expr.compile(src, error)) {
+      return std::nullopt;
+    }
+    cbox::expression::env env{i, rng, [](const std::string &path) -> std::optional<std::string> {
+        if(path == "x") {
+          return std::string("41");
+        }
+        return std::nullopt;
+      }
+    };
+    cbox::expression::value val;
+    if(!expr.eval(env, val, error)) {
+      return std::nullopt;
+    }
+    return val.as_string();
+  };
+
+  ASSERT_EQ(eval("1 + 2 * 3", 0), "7");
+  ASSERT_EQ(eval("(1 + 2) * 3 - 10 / 4", 0), "6.5");
+  ASSERT_EQ(eval("7 % 3", 0), "1");
+  ASSERT_EQ(eval("-i + 10", 4), "6");
+  ASSERT_EQ(eval("i > 2 && i < 5 ? 'in' : 'out'", 3), "in");
+  ASSERT_EQ(eval("i > 2 && i < 5 ? 'in' : 'out'", 5), "out");
+  ASSERT_EQ(eval("!(i == 1) || false", 1), "false");
+  ASSERT_EQ(eval("'a' + 1 + 2", 0), "a12");
+  ASSERT_EQ(eval("\"obj-\" + i", 9), "obj-9");
+  ASSERT_EQ(eval("ref('x') + 1", 0), "411");
+  ASSERT_EQ(eval("rand(1)", 0), "0");
+
+  //failures
+  ASSERT_FALSE(eval("1 +", 0));
+  ASSERT_FALSE(eval("(1 + 2", 0));
+  ASSERT_FALSE(eval("'open", 0));
+  ASSERT_FALSE(eval("foo + 1", 0));
+  ASSERT_NE(error.find("unknown identifier"), std::string::npos);
+  ASSERT_FALSE(eval("ref('y')", 0));
+  ASSERT_NE(error.find("unresolved reference"), std::string::npos);
+}
+
+TEST_F(cbox_test, SetTreeNode_Copy)
+{
+  std::vector<char> buf;
+  ryml::Tree src = ryml::parse_in_arena(R"({a: "1", b: ~, c: [x, !!str 2], d: {e: f}})");
+
+  //an unkeyed map merged into a map of another tree, structurally
+  ryml::Tree dst;
+  dst.rootref() |= ryml::MAP;
+  dst.rootref()["z"] << "0";
+  utils::set_tree_node(src, src.crootref(), dst.rootref(), buf);
+  ASSERT_TRUE(buf.empty());
+  ryml::ConstNodeRef root = dst.crootref();
+  ASSERT_EQ(root.num_children(), 5u);
+  ASSERT_EQ(str_of(root["z"]), "0");
+  ASSERT_EQ(str_of(root["a"]), "1");
+  ASSERT_TRUE(root["a"].is_val_quoted());
+  ASSERT_TRUE(root["b"].val_is_null());
+  ASSERT_EQ(str_of(root["c"][0]), "x");
+  ASSERT_EQ(root["c"][1].val_tag(), "!!str");
+  ASSERT_EQ(str_of(root["d"]["e"]), "f");
+
+  //the copy owns its strings
+  ASSERT_FALSE(src.arena().is_super(root["d"]["e"].val()));
+  ASSERT_TRUE(dst.arena().is_super(root["d"]["e"].val()));
+
+  //a keyed node is added as a child
+  ryml::Tree keyed;
+  keyed.rootref() |= ryml::MAP;
+  utils::set_tree_node(src, src.crootref()["d"], keyed.rootref(), buf);
+  ASSERT_EQ(str_of(keyed.crootref()["d"]["e"]), "f");
+
+  //a copy into the source itself falls back to emit and parse
+  ryml::NodeRef into = src.rootref().append_child();
+  into << ryml::key("copy");
+  into |= ryml::MAP;
+  utils::set_tree_node(src, src.crootref(), into, buf);
+  ASSERT_FALSE(buf.empty());
+  ASSERT_EQ(str_of(src.crootref()["copy"]["a"]), "1");
+  ASSERT_EQ(str_of(src.crootref()["copy"]["d"]["e"]), "f");
+  ASSERT_EQ(str_of(src.crootref()["d"]["e"]), "f");
+
+  //so does a subtree holding references
+  ryml::Tree refs = ryml::parse_in_arena("{a: &x v, b: *x}");
+  ryml::Tree refs_dst;
+  refs_dst.rootref() |= ryml::MAP;
+  buf.clear();
+  utils::set_tree_node(refs, refs.crootref(), refs_dst.rootref(), buf);
+  ASSERT_FALSE(buf.empty());
+  ASSERT_EQ(refs_dst.crootref()["a"].val_anchor(), "x");
+  ASSERT_TRUE(refs_dst.crootref()["b"].is_val_ref());
+}
+
+TEST_F(cbox_test, Parse_ScalarKind)
+{
+  ryml::Tree t = ryml::parse_in_arena(R"({a: 007, b: 1e3, c: "41", d: true, e: ~, f: inf, g: -2, h: +3, i: .5, j: "", k: 1x})");
+  ryml::ConstNodeRef root = t.crootref();
+  ASSERT_EQ(utils::scalar_kind_of(root["a"]), utils::scalar_int);
+  ASSERT_EQ(utils::scalar_kind_of(root["b"]), utils::scalar_float);
+  ASSERT_EQ(utils::scalar_kind_of(root["c"]), utils::scalar_string);
+  ASSERT_EQ(utils::scalar_kind_of(root["d"]), utils::scalar_bool);
+  ASSERT_EQ(utils::scalar_kind_of(root["e"]), utils::scalar_null);
+  ASSERT_EQ(utils::scalar_kind_of(root["f"]), utils::scalar_string);
+  ASSERT_EQ(utils::scalar_kind_of(root["g"]), utils::scalar_int);
+  ASSERT_EQ(utils::scalar_kind_of(root["h"]), utils::scalar_int);
+  ASSERT_EQ(utils::scalar_kind_of(root["i"]), utils::scalar_float);
+  ASSERT_EQ(utils::scalar_kind_of(root["j"]), utils::scalar_string);
+  ASSERT_EQ(utils::scalar_kind_of(root["k"]), utils::scalar_string);
+
+  ASSERT_EQ(utils::parse<bool>("TRUE"), true);
+  ASSERT_EQ(utils::parse<bool>("False"), false);
+  ASSERT_EQ(utils::parse<bool>("1"), true);
+  ASSERT_EQ(utils::parse<bool>("0"), false);
+  ASSERT_FALSE(utils::parse<bool>("yes"));
+  ASSERT_FALSE(utils::parse<bool>("01"));
+}
+
+TEST_F(cbox_test, Function_LazyData)
+{
+  //with no output nothing is dumped, the data of a mocked request
+  //is computed only because a function can read it back
+  env_->event_log_->set_level(spdlog::level::level_enum::off);
+  env_->cfg_.no_out_ = true;
+  env_->cfg_.in_path = "scenarios";
+  env_->cfg_.in_name = "15_function.json";
+  ASSERT_EQ(env_->exec(), 0);
+}
+
+TEST_F(cbox_test, Function_BigIntegers)
+{
+  ryml::Tree out;
+  ASSERT_EQ(run_scenario("15_function.json", out), 0);
+  ryml::ConstNodeRef requests = requests_of(first_doc(out));
+
+  //integers beyond 2^53, or beyond int64, reach JS as strings and keep their digits
+  ASSERT_EQ(str_of(requests[2]["uri"]),
+            "number:9007199254740991|string:9007199254740993|string:123456789012345678901234567890");
+}
+
+TEST_F(cbox_test, Query_2Conv_7Req)
+{
+  ryml::Tree out;
+  ASSERT_EQ(run_scenario("5_query.json", out), 0);
+  ryml::ConstNodeRef requests = requests_of(first_doc(out));
+  ASSERT_EQ(requests.num_children(), 6u);
+
+  //the request in progress has no response yet, it is not selected
+  ASSERT_EQ(str_of(requests[3]["uri"]), "c");
+  ASSERT_EQ(str_of(requests[4]["uri"]), "b-x");
+
+  //the lazy index built by requests[3] catches up with the requests added since
+  ASSERT_EQ(str_of(requests[5]["uri"]), "b-x_a,c,c");
+
+  //[*], [-n], an index after [*] and after a filter
+  ASSERT_EQ(str_of(requests_of(first_doc(out), 1)[0]["uri"]),
+            "a,b,c,c,b-x,b-x_a,c,c|b-x|b|b-x_a,c,c");
+}
+
+TEST_F(cbox_test, Stream_1Conv_5Req)
+{
+  env_->cfg_.stream_out_ = true;
+  ryml::Tree out;
+  ASSERT_EQ(run_scenario("6_stream.json", out), 0);
+  ryml::ConstNodeRef docs = out.crootref();
+
+  //a record per request, one for the conversation, the stats last
+  ASSERT_TRUE(docs.is_stream());
+  ASSERT_EQ(docs.num_children(), 7u);
+  const char *uris[] = {"a", "a", "a", "b", "b"};
+  const char *codes[] = {"200", "200", "200", "404", "200"};
+  for(size_t i = 0; i < 5; ++i) {
+    ASSERT_EQ(str_of(docs[i]["conversation"]), "0");
+    ASSERT_EQ(str_of(docs[i]["request"]["uri"]), uris[i]);
+    ASSERT_EQ(str_of(docs[i]["request"]["response"]["code"]), codes[i]);
+  }
+  ASSERT_EQ(str_of(docs[3]["request"]["id"]), "kept");
+
+  //the conversation is written without its requests
+  ASSERT_EQ(str_of(docs[5]["conversation"]), "0");
+  ASSERT_EQ(str_of(docs[5]["host"]), "localhost:80");
+  ASSERT_FALSE(docs[5].has_child("requests"));
+  ASSERT_EQ(str_of(docs[5]["stats"]["requests"]), "5");
+
+  ASSERT_FALSE(docs[6].has_child("conversations"));
+  ASSERT_EQ(str_of(docs[6]["stats"]["requests"]), "5");
+  ASSERT_EQ(str_of(docs[6]["stats"]["categorization"]["200"]), "4");
+}
+
+TEST_F(cbox_test, NDJSON_1Conv_5Req)
+{
+  env_->event_log_->set_level(spdlog::level::level_enum::off);
+  env_->cfg_.out_format = STR_NDJSON;
+  env_->cfg_.out_channel = tmp_file("out.ndjson");
+  env_->cfg_.in_path = "scenarios";
+  env_->cfg_.in_name = "6_stream.json";
+  ASSERT_EQ(env_->exec(), 0);
+
+  std::ifstream in(env_->cfg_.out_channel);
+  std::vector<std::string> lines;
+  for(std::string line; std::getline(in, line);) {
+    lines.push_back(line);
+  }
+
+  //a line per request, nothing else
+  ASSERT_EQ(lines.size(), 5u);
+  const char *uris[] = {"a", "a", "a", "b", "b"};
+  const char *codes[] = {"200", "200", "200", "404", "200"};
+  for(size_t i = 0; i < lines.size(); ++i) {
+    ryml::Tree event = ryml::parse_json_in_arena(ryml::to_csubstr(lines[i]));
+    ryml::ConstNodeRef root = event.crootref();
+    ASSERT_EQ(str_of(root["scenario"]), "0");
+    ASSERT_EQ(str_of(root["conversation"]), "0");
+    ASSERT_EQ(str_of(root["request"]), utils::to_str(i));
+    ASSERT_EQ(str_of(root["method"]), "HEAD");
+    ASSERT_EQ(str_of(root["uri"]), uris[i]);
+    ASSERT_EQ(str_of(root["code"]), codes[i]);
+    ASSERT_EQ(str_of(root["sent"]), "0");
+    ASSERT_EQ(str_of(root.find_child("id")), i == 3 ? "kept" : "<none>");
+  }
+}
+
+TEST_F(cbox_test, NDJSON_NoOut)
+{
+  env_->event_log_->set_level(spdlog::level::level_enum::off);
+  env_->cfg_.no_out_ = true;
+  env_->cfg_.out_format = STR_NDJSON;
+  env_->cfg_.out_channel = tmp_file("out.ndjson");
+  env_->cfg_.in_path = "scenarios";
+  env_->cfg_.in_name = "6_stream.json";
+  ASSERT_EQ(env_->exec(), 0);
+
+  //no output, no events
+  std::ifstream in(env_->cfg_.out_channel);
+  std::string line;
+  ASSERT_FALSE(std::getline(in, line));
+}
+
+TEST_F(cbox_test, Aggregate_1Conv_3Req)
+{
+  ryml::Tree out;
+  ASSERT_EQ(run_scenario("7_aggregate.json", out), 0);
+  ryml::ConstNodeRef scenario_out = first_doc(out);
+  ryml::ConstNodeRef requests = requests_of(scenario_out);
+
+  //a node per request, whatever the number of iterations
+  ASSERT_EQ(requests.num_children(), 3u);
+
+  ryml::ConstNodeRef loop = requests[0];
+  ASSERT_EQ(str_of(loop["id"]), "loop");
+  ASSERT_EQ(str_of(loop["uri"]), "obj-99");
+  ryml::ConstNodeRef iterations = loop["iterations"];
+  ASSERT_EQ(str_of(iterations["count"]), "100");
+  ASSERT_EQ(str_of(iterations["failed"]), "0");
+  ASSERT_EQ(iterations["categorization"].num_children(), 1u);
+  ASSERT_EQ(str_of(iterations["categorization"]["200"]), "100");
+  for(const char *q : {"p50", "p90", "p99", "max"}) {
+    ASSERT_TRUE(iterations["rtt"].has_child(ryml::to_csubstr(q)));
+  }
+  ASSERT_EQ(str_of(iterations["samples"]["first"]["uri"]), "obj-0");
+  ASSERT_EQ(str_of(iterations["samples"]["last"]["uri"]), "obj-99");
+  ASSERT_FALSE(iterations["samples"].has_child("failed"));
+
+  //the first iteration is the first failed one too
+  ryml::ConstNodeRef failing = requests[1]["iterations"];
+  ASSERT_EQ(str_of(failing["count"]), "5");
+  ASSERT_EQ(str_of(failing["failed"]), "5");
+  ASSERT_EQ(str_of(failing["categorization"]["503"]), "5");
+  ASSERT_EQ(str_of(failing["samples"]["first"]["response"]["code"]), "503");
+  ASSERT_EQ(str_of(failing["samples"]["failed"]["uri"]), "err");
+
+  //an id refers to the last iteration
+  ASSERT_EQ(str_of(requests[2]["uri"]), "obj-99");
+
+  ASSERT_EQ(str_of(scenario_out["stats"]["requests"]), "106");
+  ASSERT_EQ(str_of(scenario_out["stats"]["categorization"]["200"]), "101");
+  ASSERT_EQ(str_of(scenario_out["stats"]["categorization"]["503"]), "5");
+}
+
+TEST_F(cbox_test, Compressed_Roundtrip)
+{
+  std::string path = tmp_file("out.gz");
+  utils::compressed_filebuf buf;
+  ASSERT_TRUE(buf.open(path, utils::compressed_filebuf::gzip, -1));
+  std::ostream os(&buf);
+  std::string line(1000, 'x');
+  size_t written = 0;
+  for(int i = 0; i < 5000; ++i) {
+    os << i << line << '\n';
+    written += utils::to_str(i).size() + line.size() + 1;
+  }
+  os.flush();
+  ASSERT_TRUE(os.good());
+  ASSERT_TRUE(buf.close());
+
+  gzFile in = gzopen(path.c_str(), "rb");
+  ASSERT_NE(in, nullptr);
+  std::string text;
+  char chunk[1 << 16];
+  for(int len; (len = gzread(in, chunk, sizeof(chunk))) > 0;) {
+    text.append(chunk, len);
+  }
+  gzclose(in);
+  ASSERT_EQ(text.size(), written);
+  ASSERT_EQ(text.substr(0, 4), "0xxx");
+}
+
+TEST_F(cbox_test, Compressed_WriteError)
+{
+  //a full disk, as /dev/full simulates it
+  std::string path = tmp_file("full.gz");
+  std::remove(path.c_str());
+  ASSERT_EQ(::symlink("/dev/full", path.c_str()), 0);
+
+  utils::compressed_filebuf buf;
+  ASSERT_TRUE(buf.open(path, utils::compressed_filebuf::gzip, -1));
+  std::ostream os(&buf);
+  os << "some output" << std::endl;
+  ASSERT_FALSE(buf.close());
+
+  //the run fails as a whole
+  env_->event_log_->set_level(spdlog::level::level_enum::off);
+  env_->cfg_.in_path = "scenarios";
+  env_->cfg_.in_name = "1_head1conv1req.json";
+  env_->cfg_.out_channel = path;
+  ASSERT_EQ(env_->exec(), 1);
+}
+
+TEST_F(cbox_test, Binary_1Conv_1Req_Decode)
+{
+  env_->event_log_->set_level(spdlog::level::level_enum::off);
+  for(const char *format : {STR_CBOR, STR_MSGPACK}) {
+    SCOPED_TRACE(format);
+    std::string bin_name = std::string(format) + ".bin";
+    env_->cfg_.out_format = format;
+    env_->cfg_.out_channel = tmp_file(bin_name.c_str());
+    env_->cfg_.decode.clear();
+    env_->cfg_.in_path = "scenarios";
+    env_->cfg_.in_name = "16_scalars.json";
+    ASSERT_EQ(env_->exec(), 0);
+
+    env_->cfg_.decode = format;
+    env_->cfg_.in_path = testing::TempDir();
+    env_->cfg_.in_name = env_->cfg_.out_channel.substr(env_->cfg_.in_path.size());
+    env_->cfg_.out_channel = tmp_file((std::string(format) + ".yaml").c_str());
+    ASSERT_EQ(env_->exec(), 0);
+
+    std::vector<char> buf;
+    int error = 0;
+    ASSERT_TRUE(utils::file_get_contents(env_->cfg_.out_channel.c_str(), buf, nullptr, error));
+    ryml::Tree out = ryml::parse_in_arena(ryml::csubstr(buf.data(), buf.size()));
+    ryml::ConstNodeRef request = requests_of(first_doc(out))[0];
+    ASSERT_EQ(str_of(request["uri"]), "scalars");
+    ASSERT_EQ(str_of(request["response"]["code"]), "200");
+
+    //every scalar decodes back to its type
+    ryml::ConstNodeRef tags = request["tags"];
+    ASSERT_EQ(str_of(tags["neg"]), "-42");
+    ASSERT_EQ(utils::scalar_kind_of(tags["neg"]), utils::scalar_int);
+    ASSERT_EQ(str_of(tags["neg64"]), "-5000000000");
+    ASSERT_EQ(utils::scalar_kind_of(tags["neg64"]), utils::scalar_int);
+    ASSERT_EQ(str_of(tags["float"]), "-2.25");
+    ASSERT_EQ(utils::scalar_kind_of(tags["float"]), utils::scalar_float);
+    ASSERT_EQ(str_of(tags["exp"]), "1000.0");
+    ASSERT_EQ(utils::scalar_kind_of(tags["exp"]), utils::scalar_float);
+    ASSERT_EQ(str_of(tags["quoted"]), "007");
+    ASSERT_TRUE(tags["quoted"].is_val_quoted());
+    ASSERT_EQ(str_of(tags["empty"]), "");
+    ASSERT_EQ(utils::scalar_kind_of(tags["empty"]), utils::scalar_string);
+    ASSERT_EQ(utils::scalar_kind_of(tags["nil"]), utils::scalar_null);
+    ASSERT_EQ(utils::scalar_kind_of(tags["yes"]), utils::scalar_bool);
+  }
+}
+
+TEST_F(cbox_test, JSONBody_1Conv_5Req)
+{
+  ryml::Tree out;
+  ASSERT_EQ(run_scenario("17_json_body.json", out), 0);
+  ryml::ConstNodeRef requests = requests_of(first_doc(out));
+
+  //the first byte tells a map from a sequence
+  ryml::ConstNodeRef map = requests[0]["response"]["body"];
+  ASSERT_TRUE(map.is_map());
+  ASSERT_EQ(str_of(map["a"][1]), "2");
+  ASSERT_EQ(str_of(map["b"]["c"]), "d");
+
+  ryml::ConstNodeRef seq = requests[1]["response"]["body"];
+  ASSERT_TRUE(seq.is_seq());
+  ASSERT_EQ(seq.num_children(), 2u);
+  ASSERT_EQ(str_of(seq[1]["k"]), "2");
+
+  //neither an object nor an array, or malformed: the raw string
+  ASSERT_EQ(str_of(requests[2]["response"]["body"]), "some-data");
+  ASSERT_EQ(str_of(requests[3]["response"]["body"]), "{\"a\": [1, ");
+
+  //the parsed bodies can be referenced
+  ASSERT_EQ(str_of(requests[4]["uri"]), "d-2");
+}
+
+TEST_F(cbox_test, OutOptions_1Conv_6Req)
+{
+  ryml::Tree out;
+  ASSERT_EQ(run_scenario("18_out_opts.json", out), 0);
+  ryml::ConstNodeRef requests = requests_of(first_doc(out));
+  ASSERT_EQ(requests.num_children(), 6u);
+
+  //every iteration gets the options of its own input node
+  for(size_t i = 0; i < 3; ++i) {
+    ASSERT_EQ(str_of(requests[i]["uri"]), "hidden-data");
+    ASSERT_FALSE(requests[i].has_child("data"));
+    ASSERT_EQ(str_of(requests[i]["response"]["body"]), "{\"k\": 1}");
+  }
+  for(size_t i = 3; i < 5; ++i) {
+    ASSERT_EQ(str_of(requests[i]["data"]), "d");
+    ASSERT_EQ(str_of(requests[i]["response"]["body"]["k"]), "1");
+  }
+  ASSERT_FALSE(requests[5].has_child("uri"));
+  ASSERT_EQ(str_of(requests[5]["data"]), "d");
+
+  //the options are resolved once per input node with an out, keyed by its id
+  env_->cfg_.out_channel = tmp_file("ctx.yaml");
+  cbox::context ctx(env_->cfg_, env_->out_hint_);
+  ASSERT_EQ(ctx.init(env_->event_log_), 0);
+  ASSERT_EQ(ctx.load_document_by_file(), 0);
+  ASSERT_EQ(ctx.process_scenario(), -1);
+  ryml::ConstNodeRef requests_in = ctx.doc_in_.crootref()["conversations"][0]["requests"];
+  const auto &cache = ctx.scenario_->out_opts_cache_;
+  ASSERT_EQ(cache.size(), 3u);
+  ASSERT_TRUE(cache.count(requests_in[0].id()));
+  ASSERT_TRUE(cache.count(requests_in[0]["response"].id()));
+  ASSERT_TRUE(cache.count(requests_in[2].id()));
+  ASSERT_FALSE(cache.at(requests_in[0].id()).dumps(utils::out_options::dump_data));
+  ASSERT_EQ(cache.at(requests_in[0]["response"].id()).body_, utils::out_options::body_string);
+  ASSERT_TRUE(cache.at(requests_in[2].id()).dumps(utils::out_options::dump_data));
+  ASSERT_EQ(cache.at(requests_in[2].id()).dump_.back(), (std::pair<std::string, bool>("uri", false)));
+}
+
+TEST_F(cbox_test, XML_1Conv_4Req)
+{
+  ryml::Tree out;
+  ASSERT_EQ(run_scenario("8_xml.json", out), 0);
+  ryml::ConstNodeRef requests = requests_of(first_doc(out));
+  ASSERT_EQ(requests.num_children(), 4u);
+
+  //the root element is the body
+  ASSERT_EQ(str_of(requests[0]["response"]["body"]["UploadId"]), "VXBsb2FkIElE");
+  ASSERT_EQ(str_of(requests[1]["uri"]), "bucket/key/VXBsb2FkIElE");
+
+  //repeated elements become a sequence
+  ryml::ConstNodeRef list = requests[2]["response"]["body"];
+  ASSERT_EQ(str_of(list["Name"]), "bucket");
+  ASSERT_TRUE(list["Contents"].is_seq());
+  ASSERT_EQ(list["Contents"].num_children(), 3u);
+  ASSERT_EQ(str_of(list["Contents"][1]["Key"]), "b & c.txt");
+  ASSERT_EQ(str_of(list["Contents"][2]["Size"]), "3");
+
+  //malformed xml is rendered as a string
+  ASSERT_EQ(str_of(requests[3]["response"]["body"]), "<Error><Code>NoSuchKey</Message></Error>");
+}
+
+TEST_F(cbox_test, XML_Decode)
+{
+  ryml::Tree t;
+  t.rootref() |= ryml::MAP;
+  std::string error;
+  ASSERT_TRUE(codec::decode_xml("<?xml version=\"1.0\"?><!-- lead --><R a=\"1>\">"
+                                "<T>a &amp; b &lt;&#x41;&#66;&gt; &quot;&apos;</T>"
+                                "<C><![CDATA[<raw> &amp;]]></C>"
+                                "<S>one<!-- split -->two</S>"
+                                "<E/>"
+                                "<L>1</L><L>2</L><L>3</L>"
+                                "<P>0001</P><I>12345678901234567890</I><B>true</B>"
+                                "</R>",
+                                t.rootref(),
+                                error)) << error;
+  ryml::ConstNodeRef root = t.crootref();
+  ASSERT_EQ(str_of(root["T"]), "a & b <AB> \"'");
+  ASSERT_EQ(str_of(root["C"]), "<raw> &amp;");
+  ASSERT_EQ(str_of(root["S"]), "onetwo");
+  ASSERT_EQ(str_of(root["E"]), "");
+  ASSERT_FALSE(root["E"].val_is_null());
+  ASSERT_TRUE(root["L"].is_seq());
+  ASSERT_EQ(str_of(root["L"][0]), "1");
+  ASSERT_EQ(str_of(root["L"][2]), "3");
+  ASSERT_EQ(utils::scalar_kind_of(root["L"][0]), utils::scalar_string);
+
+  //text is never typed: it reaches templates and JS as written
+  ASSERT_EQ(str_of(root["P"]), "0001");
+  ASSERT_EQ(utils::scalar_kind_of(root["P"]), utils::scalar_string);
+  ASSERT_EQ(str_of(root["I"]), "12345678901234567890");
+  ASSERT_EQ(utils::scalar_kind_of(root["I"]), utils::scalar_string);
+  ASSERT_EQ(utils::scalar_kind_of(root["B"]), utils::scalar_string);
+
+  for(const char *bad : {"<R><T>x</R>", "<R>", "no root", "<R>&bogus</R>", "<R/><S/>"}) {
+    ryml::Tree bad_t;
+    bad_t.rootref() |= ryml::MAP;
+    ASSERT_FALSE(codec::decode_xml(ryml::to_csubstr(bad), bad_t.rootref(), error)) << bad;
+  }
+}
+
+TEST_F(cbox_test, Workers_3Conv_4Req)
+{
+  env_->cfg_.workers = 2;
+  ryml::Tree out;
+  ASSERT_EQ(run_scenario("9_workers.json", out), 0);
+  ryml::ConstNodeRef scenario_out = first_doc(out);
+
+  //the shards are merged back in the order of a sequential run
+  ASSERT_EQ(scenario_out["conversations"].num_children(), 3u);
+  ASSERT_EQ(str_of(requests_of(scenario_out, 0)[0]["uri"]), "conv-0");
+  ASSERT_EQ(requests_of(scenario_out, 1).num_children(), 2u);
+  ASSERT_EQ(str_of(requests_of(scenario_out, 1)[1]["uri"]), "conv-1");
+  ASSERT_EQ(str_of(requests_of(scenario_out, 2)[0]["uri"]), "conv-2");
+
+  ryml::ConstNodeRef stats = scenario_out["stats"];
+  ASSERT_EQ(str_of(stats["conversations"]), "3");
+  ASSERT_EQ(str_of(stats["requests"]), "4");
+  ASSERT_EQ(str_of(stats["categorization"]["200"]), "2");
+  ASSERT_EQ(str_of(stats["categorization"]["404"]), "2");
+
+  //mocked responses never open a connection
+  ASSERT_FALSE(stats.has_child("connections"));
+}
+
+TEST_F(cbox_test, Interner_Handles)
+{
+  utils::interner interner;
+  utils::interner::handle h200 = interner.intern("200");
+  utils::interner::handle h404 = interner.intern(std::string("404"));
+  ASSERT_NE(h200, h404);
+  ASSERT_EQ(interner.intern("200"), h200);
+  ASSERT_EQ(interner.find("404"), h404);
+  ASSERT_FALSE(interner.find("500"));
+
+  //interning more strings never moves the ones already interned
+  const std::string *s200 = &interner.str(h200);
+  for(int i = 0; i < 1000; ++i) {
+    interner.intern(utils::to_str(i + 1000));
+  }
+  ASSERT_EQ(&interner.str(h200), s200);
+  ASSERT_EQ(interner.str(h404), "404");
+  ASSERT_EQ(interner.find("200"), h200);
+}
+
+TEST_F(cbox_test, Stats_MergeShards)
+{
+  utils::capacity_hint hint;
+  cbox::context ctx(env_->cfg_, hint);
+  cbox::scenario parent(ctx), shard(ctx);
+
+  //the shard interns the codes in another order, so its handles differ
+  parent.stats_.incr_categorization(parent.interner_.intern("200"));
+  shard.interner_.intern("conv-id");
+  shard.stats_.incr_categorization(shard.interner_.intern("404"));
+  shard.stats_.incr_categorization(shard.interner_.intern("200"));
+  shard.stats_.incr_categorization(shard.interner_.intern("200"));
+  shard.stats_.incr_conversation_count();
+  shard.stats_.incr_request_count();
+  shard.stats_.incr_request_count();
+  shard.stats_.incr_request_count();
+
+  utils::conn_stats conn;
+  conn.created = 1;
+  conn.peak = 2;
+  parent.stats_.record_connection("localhost:80", conn);
+  conn.created = 2;
+  conn.reused = 3;
+  conn.peak = 1;
+  shard.stats_.record_connection("localhost:80", conn);
+
+  parent.stats_.merge(shard.stats_);
+
+  ryml::Tree out;
+  out.rootref() |= ryml::MAP;
+  parent.enrich_with_stats(out.rootref());
+  ryml::ConstNodeRef stats = out.crootref()["stats"];
+  ASSERT_EQ(str_of(stats["conversations"]), "1");
+  ASSERT_EQ(str_of(stats["requests"]), "3");
+  ASSERT_EQ(stats["categorization"].num_children(), 2u);
+  ASSERT_EQ(str_of(stats["categorization"]["200"]), "3");
+  ASSERT_EQ(str_of(stats["categorization"]["404"]), "1");
+  ASSERT_FALSE(stats["categorization"].has_child("conv-id"));
+  ASSERT_EQ(str_of(stats["connections"]["localhost:80"]["new"]), "3");
+  ASSERT_EQ(str_of(stats["connections"]["localhost:80"]["reused"]), "3");
+  ASSERT_EQ(str_of(stats["connections"]["localhost:80"]["peak"]), "2");
+}
+
+TEST_F(cbox_test, Workers_StopAtFailure)
+{
+  env_->cfg_.workers = 2;
+  ryml::Tree out;
+  ASSERT_EQ(run_scenario("19_workers_fail.json", out), 1);
+  ryml::ConstNodeRef scenario_out = first_doc(out);
+  ASSERT_EQ(str_of(scenario_out["errorOccurred"]), "true");
+  ASSERT_EQ(scenario_out["conversations"].num_children(), 4u);
+
+  ASSERT_EQ(str_of(requests_of(scenario_out, 0)[0]["response"]["code"]), "200");
+  ASSERT_TRUE(requests_of(scenario_out, 1)[0].has_child("error"));
+
+  //the worker that failed runs nothing else, the conversation stays as its input
+  ryml::ConstNodeRef left_out = scenario_out["conversations"][3];
+  ASSERT_EQ(str_of(left_out["error"]), "not run, a previous conversation failed");
+  ASSERT_FALSE(requests_of(scenario_out, 3)[0].has_child("response"));
+}
+
+TEST_F(cbox_test, Throttle_1Conv_3Req)
+{
+  test_server server;
+  ryml::Tree out;
+  ASSERT_EQ(run_scenario("10_throttle.json", out, {{"TEST_SERVER_PORT", utils::to_str(server.port())},
+    {"UPLOAD_DATA", std::string(20000, 'u')}
+  }), 0);
+  ryml::ConstNodeRef requests = requests_of(first_doc(out));
+  ASSERT_EQ(requests.num_children(), 3u);
+
+  //20000 bytes up at 10000 B/s, as curl measured the transfer
+  ryml::ConstNodeRef upload = requests[0]["response"];
+  ASSERT_EQ(str_of(upload["code"]), "200");
+  ASSERT_EQ(str_of(upload["body"]), "20000");
+  ASSERT_EQ(str_of(upload["stats"]["sent"]), "20000");
+  auto upload_rate = utils::parse<uint64_t>(str_of(upload["stats"]["upload"]));
+  ASSERT_TRUE(upload_rate);
+  ASSERT_GT(*upload_rate, 0u);
+  ASSERT_LE(*upload_rate, 11000u);
+
+  //200000 bytes down at 100000 B/s
+  ryml::ConstNodeRef download = requests[1]["response"];
+  ASSERT_EQ(str_of(download["code"]), "200");
+  ASSERT_EQ(str_of(download["stats"]["received"]), "200000");
+  auto download_rate = utils::parse<uint64_t>(str_of(download["stats"]["download"]));
+  ASSERT_TRUE(download_rate);
+  ASSERT_GT(*download_rate, 0u);
+  ASSERT_LE(*download_rate, 110000u);
+
+  //a mocked response has no transfer
+  ASSERT_EQ(str_of(requests[2]["response"]["code"]), "200");
+  ASSERT_FALSE(requests[2]["response"].has_child("stats"));
+}
+
+TEST_F(cbox_test, ParseRate)
+{
+  ASSERT_EQ(utils::parse_rate("512"), 512u);
+  ASSERT_EQ(utils::parse_rate("256KiB/s"), 262144u);
+  ASSERT_EQ(utils::parse_rate("1.5MB"), 1500000u);
+  ASSERT_EQ(utils::parse_rate("2 GiB/s"), 2147483648u);
+  ASSERT_FALSE(utils::parse_rate("fast"));
+  ASSERT_FALSE(utils::parse_rate("10 kb"));
+}
+
+TEST_F(cbox_test, Connections_2Conv_4Req)
+{
+  test_server server;
+  ryml::Tree out;
+
+  //a fresh connection per request
+  std::string local_host = "127.0.0.1:" + utils::to_str(server.port());
+  ASSERT_EQ(run_scenario("11_connections.json", out, {{"TEST_SERVER_PORT", utils::to_str(server.port())}}), 0);
+  ryml::ConstNodeRef connections = first_doc(out)["stats"]["connections"];
+  ryml::ConstNodeRef local = connections[ryml::to_csubstr(local_host)];
+  ASSERT_EQ(str_of(local["new"]), "3");
+  ASSERT_EQ(str_of(local["reused"]), "0");
+  ASSERT_EQ(str_of(local["errors"]), "0");
+  ASSERT_EQ(str_of(local["tls"]), "0");
+  ASSERT_EQ(str_of(local["peak"]), "1");
+
+  //a refused connection is an error, nothing was opened
+  ryml::ConstNodeRef refused = connections["127.0.0.1:1"];
+  ASSERT_EQ(str_of(refused["new"]), "0");
+  ASSERT_EQ(str_of(refused["reused"]), "0");
+  ASSERT_EQ(str_of(refused["errors"]), "1");
+
+  //one pooled connection, reused by the following requests
+  env_->cfg_.keep_alive = true;
+  ASSERT_EQ(run_scenario("11_connections.json", out, {{"TEST_SERVER_PORT", utils::to_str(server.port())}}), 0);
+  local = first_doc(out)["stats"]["connections"][ryml::to_csubstr(local_host)];
+  ASSERT_EQ(str_of(local["new"]), "1");
+  ASSERT_EQ(str_of(local["reused"]), "2");
+  ASSERT_EQ(str_of(local["peak"]), "1");
+}
+
+TEST_F(cbox_test, Template_1Conv_2Req)
+{
+  ryml::Tree out;
+  ASSERT_EQ(run_scenario("12_template.json", out), 0);
+  ryml::ConstNodeRef requests = requests_of(first_doc(out));
+  ASSERT_EQ(requests.num_children(), 3u);
+
+  //rendered in a single pass, a $ in a resolved value is kept as it is
+  ASSERT_EQ(str_of(requests[1]["uri"]), "p$1q-HEAD/200");
+  ASSERT_EQ(str_of(requests[2]["uri"]), "p$1q-HEAD/200");
+}
+
+TEST_F(cbox_test, TemplateCache_RecycledNodeId)
+{
+  cbox::scenario_property_evaluator spe;
+  spe.init(env_->event_log_);
+
+  ryml::Tree t = ryml::parse_in_arena("{a: 'x{{p.q}}y'}");
+  size_t id = t["a"].id();
+  const cbox::scenario_property_template &tpl = spe.get_template(t["a"]);
+  ASSERT_EQ(tpl.segments_.size(), 3u);
+  ASSERT_EQ(tpl.segments_[0].kind, cbox::scenario_property_template::text);
+  ASSERT_EQ(tpl.segments_[0].text, "x");
+  ASSERT_EQ(tpl.segments_[1].kind, cbox::scenario_property_template::path);
+  ASSERT_EQ(tpl.segments_[1].text, "p.q");
+  ASSERT_EQ(tpl.segments_[2].text, "y");
+
+  //the freed id is taken by a new node: the cached template is compiled again
+  t.rootref().remove_child("a");
+  ryml::NodeRef b = t.rootref().append_child();
+  b << ryml::key("b") << "{{= 1 + 2}}";
+  ASSERT_EQ(b.id(), id);
+  const cbox::scenario_property_template &tpl_b = spe.get_template(b);
+  ASSERT_EQ(tpl_b.segments_.size(), 1u);
+  ASSERT_EQ(tpl_b.segments_[0].kind, cbox::scenario_property_template::expr);
+}
+
+TEST_F(cbox_test, FieldIndex_Invalidation)
+{
+  utils::capacity_hint hint;
+  cbox::context ctx(env_->cfg_, hint);
+  cbox::scenario parent(ctx);
+  cbox::scenario_property_resolver spr(parent);
+  spr.init(env_->event_log_);
+
+  ryml::Tree t = ryml::parse_in_arena("{conversations: [{id: x, requests: [{k: a, n: 1}, {k: b, n: 2}, {k: a, n: 3}]}, "
+                                      "{id: y}, {id: x}]}");
+  spr.reset(t.crootref());
+  std::string out;
+  ASSERT_TRUE(spr.render(".conversations[0].requests[?k==a].n", out));
+  ASSERT_EQ(out, "1,3");
+
+  //the sequence is rebuilt on recycled ids: the index is not trusted anymore
+  ryml::NodeRef requests = t["conversations"][0]["requests"];
+  requests.clear_children();
+  spr.requests_cleared();
+  for(const char *k : {"b", "a", "b"}) {
+    ryml::NodeRef req = requests.append_child();
+    req |= ryml::MAP;
+    req["k"] << ryml::to_csubstr(k);
+    req["n"] << requests.num_children() + 3;
+  }
+  out.clear();
+  ASSERT_TRUE(spr.render(".conversations[0].requests[?k==a].n", out));
+  ASSERT_EQ(out, "5");
+
+  //the conversations sequence is matched live, any of its children may change
+  out.clear();
+  ASSERT_TRUE(spr.render(".conversations[?id==x].id", out));
+  ASSERT_EQ(out, "x,x");
+  t["conversations"][0]["id"] << "z";
+  out.clear();
+  ASSERT_TRUE(spr.render(".conversations[?id==x].id", out));
+  ASSERT_EQ(out, "x");
+}
+
+TEST_F(cbox_test, RequestPlan_Compile)
+{
+  ryml::Tree t = ryml::parse_in_arena("{for: 3, method: PUT, uri: 'obj-{{= i}}', data: {k: v}, auth: {function: f}}");
+  std::vector<char> buf;
+  cbox::request_plan plan;
+  plan.compile(t.rootref(), buf);
+
+  ASSERT_EQ(plan.for_.kind, cbox::request_plan::literal);
+  ASSERT_EQ(plan.for_count_, 3u);
+  ASSERT_EQ(plan.method_.kind, cbox::request_plan::literal);
+  ASSERT_EQ(plan.http_method_, utils::http_put);
+  ASSERT_EQ(plan.uri_.kind, cbox::request_plan::templated);
+  ASSERT_EQ(plan.uri_.value, "obj-{{= i}}");
+  ASSERT_EQ(plan.id_.kind, cbox::request_plan::absent);
+  ASSERT_EQ(plan.query_string_.kind, cbox::request_plan::absent);
+  ASSERT_EQ(plan.auth_.kind, cbox::request_plan::scripted);
+
+  //structured data is sent as its yaml text
+  ASSERT_EQ(plan.data_.kind, cbox::request_plan::literal);
+  ASSERT_NE(plan.data_.value.find("k: v"), std::string::npos);
+
+  //a replayed request takes its templated fields as literals
+  plan.as_recorded();
+  ASSERT_EQ(plan.uri_.kind, cbox::request_plan::literal);
+  ASSERT_EQ(plan.auth_.kind, cbox::request_plan::scripted);
+  ASSERT_EQ(plan.http_method_, utils::http_put);
+}
+
+TEST_F(cbox_test, ScenarioPlan_OutCapacity)
+{
+  std::vector<char> buf;
+  size_t nodes = 0, arena = 0;
+  auto capacity = [&](const char *yaml, bool &exact) {
+    ryml::Tree t = ryml::parse_in_arena(ryml::to_csubstr(yaml));
+    cbox::scenario_plan plan;
+    plan.compile(t.rootref(), buf);
+    exact = plan.out_capacity(false, nodes, arena);
+  };
+  bool exact = false;
+
+  //each iteration is reserved for
+  capacity("{conversations: [{requests: [{for: 1, uri: a}]}]}", exact);
+  ASSERT_TRUE(exact);
+  size_t one_nodes = nodes, one_arena = arena;
+  capacity("{conversations: [{requests: [{for: 10, uri: a}]}]}", exact);
+  ASSERT_TRUE(exact);
+  ASSERT_GT(nodes, one_nodes);
+  size_t iteration_nodes = (nodes - one_nodes) / 9;
+  size_t iteration_arena = (arena - one_arena) / 9;
+
+  //a long 'for' is counted up to the reserved iterations
+  capacity("{conversations: [{requests: [{for: 5000, uri: a}]}]}", exact);
+  ASSERT_FALSE(exact);
+  ASSERT_EQ(nodes, one_nodes + (cbox::scenario_plan::reserved_iterations - 1) * iteration_nodes);
+  ASSERT_EQ(arena, one_arena + (cbox::scenario_plan::reserved_iterations - 1) * iteration_arena);
+
+  //an aggregated one is exact whatever its length
+  capacity("{conversations: [{requests: [{for: 5000000, uri: a, out: {iterations: aggregate}}]}]}", exact);
+  ASSERT_TRUE(exact);
+  ASSERT_LT(nodes, 10 * one_nodes);
+
+  //many requests are capped by the budget
+  std::string many = "{conversations: [{requests: [";
+  for(int i = 0; i < 2000; ++i) {
+    many += i ? ", {for: 1000, uri: a}" : "{for: 1000, uri: a}";
+  }
+  many += "]}]}";
+  capacity(many.c_str(), exact);
+  ASSERT_FALSE(exact);
+  ASSERT_EQ(nodes, cbox::scenario_plan::reserved_nodes);
+  ASSERT_LE(arena, cbox::scenario_plan::reserved_arena);
+}
+
+TEST_F(cbox_test, ScenarioPlan_StaticOut)
+{
+  std::vector<char> buf;
+  ryml::Tree t = ryml::parse_in_arena("{before: {function: f}, out: {dump: {enabled: false}}, conversations: ["
+                                      "{out: {dump: {host: false}}, requests: ["
+                                      "{uri: a, out: {dump: {data: false}}, response: {out: {format: {body: string}}}}, "
+                                      "{uri: b, out: {dump: {data: '{{x}}'}}}, "
+                                      "{uri: c, before: {function: g}, out: {dump: {uri: false}}, "
+                                      "response: {out: {format: {body: json}}}}]}]}");
+  cbox::scenario_plan plan;
+  plan.compile(t.crootref(), buf);
+  ryml::ConstNodeRef conversation = t.crootref()["conversations"][0];
+  ryml::ConstNodeRef requests = conversation["requests"];
+
+  //the scenario and the request-outs are copies of their inputs when their scope opens
+  ASSERT_TRUE(plan.static_out(t.crootref()));
+  ASSERT_TRUE(plan.static_out(requests[0]));
+  ASSERT_TRUE(plan.static_out(requests[2]));
+
+  //the scenario's handler can rewrite a conversation-out before its scope opens
+  ASSERT_FALSE(plan.static_out(conversation));
+
+  //a templated out is not read as written
+  ASSERT_FALSE(plan.static_out(requests[1]));
+
+  //a response-out can be rewritten by its request's scripts
+  ASSERT_TRUE(plan.static_out(requests[0]["response"]));
+  ASSERT_FALSE(plan.static_out(requests[2]["response"]));
+
+  //nodes with no out and nodes of other trees
+  ryml::Tree other = ryml::parse_in_arena("{out: {}}");
+  ASSERT_FALSE(plan.static_out(requests[0]["uri"]));
+  ASSERT_FALSE(plan.static_out(other.crootref()));
+}
+
+TEST_F(cbox_test, OutOptions_DumpKeys)
+{
+  utils::out_options opts;
+  ASSERT_TRUE(opts.dumps(utils::out_options::dump_data));
+  opts.set_dump("data", false);
+  opts.set_dump("uri", false);
+  ASSERT_FALSE(opts.dumps(utils::out_options::dump_data));
+  ASSERT_TRUE(opts.dumps(utils::out_options::dump_out));
+  ASSERT_TRUE(opts.dumps(utils::out_options::dump_auth));
+  opts.set_dump("data", true);
+  ASSERT_TRUE(opts.dumps(utils::out_options::dump_data));
+  ASSERT_EQ(opts.dump_.size(), 2u);
+
+  //the defaults hide out, whatever else they list
+  ASSERT_FALSE(utils::get_default_request_out_options().dumps(utils::out_options::dump_out));
+  ASSERT_TRUE(utils::out_options::dump_key_of("queryString") == utils::out_options::dump_query_string);
+  ASSERT_FALSE(utils::out_options::dump_key_of("uri"));
+}
+
+TEST_F(cbox_test, Plan_1Conv_1Req)
+{
+  ryml::Tree out;
+  ASSERT_EQ(run_scenario("4_expr.json", out), 0);
+  ryml::ConstNodeRef requests = requests_of(first_doc(out));
+
+  //a templated field is rendered per iteration, a literal one is copied as it is
+  ASSERT_EQ(requests.num_children(), 3u);
+  for(size_t i = 0; i < 3; ++i) {
+    ASSERT_EQ(str_of(requests[i]["method"]), "PUT");
+    ASSERT_EQ(str_of(requests[i]["uri"]), "obj-" + std::to_string(i));
+    ASSERT_FALSE(requests[i].has_child("for"));
+  }
+}
+
+TEST_F(cbox_test, PropertyPath_Compile)
+{
+  cbox::scenario_property_path cpath;
+
+  cpath.compile("conv.requests[2].uri");
+  ASSERT_EQ(cpath.root_, cbox::scenario_property_path::id);
+  ASSERT_EQ(cpath.id_, "conv");
+  ASSERT_EQ(cpath.steps_.size(), 3u);
+  ASSERT_EQ(cpath.steps_[0].kind, cbox::scenario_property_path::by_key);
+  ASSERT_EQ(cpath.steps_[0].key, "requests");
+  ASSERT_EQ(cpath.steps_[1].kind, cbox::scenario_property_path::by_index);
+  ASSERT_EQ(cpath.steps_[1].idx, 2u);
+  ASSERT_EQ(cpath.steps_[2].key, "uri");
+  ASSERT_FALSE(cpath.query_);
+
+  cpath.compile(".[1][0].response.code");
+  ASSERT_EQ(cpath.root_, cbox::scenario_property_path::quick);
+  ASSERT_EQ(cpath.conv_idx_, 1u);
+  ASSERT_EQ(cpath.req_idx_, 0u);
+  ASSERT_EQ(cpath.steps_.size(), 2u);
+  ASSERT_EQ(cpath.steps_[1].key, "code");
+
+  cpath.compile(".conversations[0]");
+  ASSERT_EQ(cpath.root_, cbox::scenario_property_path::root);
+  ASSERT_EQ(cpath.steps_.size(), 2u);
+
+  cpath.compile("conv.requests[x]");
+  ASSERT_EQ(cpath.steps_.back().kind, cbox::scenario_property_path::bad_index);
+}
+
+TEST_F(cbox_test, PropertyPath_1Conv_2Req)
+{
+  ryml::Tree out;
+  ASSERT_EQ(run_scenario("13_paths.json", out), 0);
+  ryml::ConstNodeRef requests = requests_of(first_doc(out));
+
+  //quick, full explicit and id paths
+  ASSERT_EQ(str_of(requests[1]["uri"]), "a-201-HEAD-a");
+}
+
+TEST_F(cbox_test, SvTok_Delimiters)
+{
+  std::string path("..a.[b]]c.");
+  std::string_view tok;
+  bool is_delimit = true;
+
+  //leading, consecutive and trailing delimiters are skipped
+  utils::sv_tok tknz(path, utils::delim_set(".[]"));
+  std::vector<std::string_view> tokens;
+  while(tknz.next_token(tok, false, &is_delimit)) {
+    ASSERT_FALSE(is_delimit);
+    tokens.push_back(tok);
+  }
+  ASSERT_EQ(tokens, (std::vector<std::string_view> {"a", "b", "c"}));
+  ASSERT_EQ(tknz.position(), path.size());
+  ASSERT_FALSE(tknz.next_token(tok));
+
+  //each delimiter comes back as a token of its own
+  tknz.reset();
+  tokens.clear();
+  std::vector<bool> delimits;
+  while(tknz.next_token(tok, true, &is_delimit)) {
+    tokens.push_back(tok);
+    delimits.push_back(is_delimit);
+  }
+  ASSERT_EQ(tokens, (std::vector<std::string_view> {".", ".", "a", ".", "[", "b", "]", "]", "c", "."}));
+  ASSERT_EQ(delimits, (std::vector<bool> {true, true, false, true, true, false, true, true, false, true}));
+
+  //only delimiters, or nothing at all
+  utils::sv_tok only_delims("[].", utils::delim_set(".[]"));
+  ASSERT_FALSE(only_delims.next_token(tok));
+  utils::sv_tok empty("", utils::delim_set(".[]"));
+  ASSERT_FALSE(empty.next_token(tok, true));
+}
+
+TEST_F(cbox_test, Parse_Charconv)
+{
+  ASSERT_EQ(utils::parse<int32_t>("42"), 42);
+  ASSERT_EQ(utils::parse<int32_t>("-7"), -7);
+  ASSERT_FALSE(utils::parse<int32_t>("42x"));
+  ASSERT_FALSE(utils::parse<int32_t>(""));
+  ASSERT_FALSE(utils::parse<int32_t>("2147483648"));
+  ASSERT_FALSE(utils::parse<uint32_t>("-1"));
+  ASSERT_EQ(utils::parse<double>("1e3"), 1000.0);
+  ASSERT_EQ(utils::parse<double>("0.25"), 0.25);
+  ASSERT_EQ(utils::parse<bool>("TRUE"), true);
+  ASSERT_EQ(utils::parse<bool>("0"), false);
+  ASSERT_FALSE(utils::parse<bool>("yes"));
+  ASSERT_EQ(utils::to_str(-17), "-17");
+  ASSERT_EQ(utils::to_str(0.5), "0.5");
+}
+
+TEST_F(cbox_test, Parse_NonNumericFor)
+{
+  //a 'for' that does not parse fails instead of reading 0
+  ryml::Tree out;
+  ASSERT_EQ(run_scenario("14_bad_for.json", out), 1);
+  ryml::ConstNodeRef scenario_out = first_doc(out);
+  ASSERT_EQ(str_of(scenario_out["errorOccurred"]), "true");
+}
@@ -1,10 +1,49 @@
 #pragma once
+#include <unistd.h>
+#include <zlib.h>
 #include "gtest/gtest.h"
 #include "scenario.h"
 
+//a local http server for the tests of real transfers, on a port the system picks:
+//PUT /upload answers with the size of the body, GET /download with 200000 bytes
+struct test_server {
+  test_server();
+  ~test_server();
+
+  uint16_t port() const;
+
+  void do_put_upload(const Pistache::Rest::Request &request,
+                     Pistache::Http::ResponseWriter response);
+
+  void do_get_download(const Pistache::Rest::Request &request,
+                       Pistache::Http::ResponseWriter response);
+
+  std::shared_ptr<Pistache::Http::Endpoint> http_endpoint_;
+  Pistache::Rest::Router router_;
+};
+
 class cbox_test : public ::testing::Test {
   protected:
     std::unique_ptr<cbox::env> env_;
     virtual void SetUp();
     virtual void TearDown();
+
+    //a path in the temp dir, removed on tear down
+    std::string tmp_file(const char *name);
+
+    //runs a scenario of the scenarios dir, out is loaded with its yaml output;
+    //the scenario is run from a copy in the temp dir when vars are replaced in it
+    int run_scenario(const char *in_name,
+                     ryml::Tree &out,
+                     const std::vector<std::pair<std::string, std::string>> &vars = {});
+
+    //the first document of an output
+    static ryml::ConstNodeRef first_doc(const ryml::Tree &out);
+
+    //the requests-out of a conversation
+    static ryml::ConstNodeRef requests_of(ryml::ConstNodeRef scenario_out, size_t conv_idx = 0);
+
+    static std::string str_of(ryml::ConstNodeRef node);
+
+    std::vector<std::string> tmp_files_;
 };